@@ -158,13 +158,23 @@ int main(int argc, char *argv[])
   if (timers_enabled) timer_stop(T_fft);
 
   for (iter = 1; iter <= niter; iter++) {
+    // start powercap code
+    powercap_phase_begin(0);
+    // end powercap code
     if (timers_enabled) timer_start(T_evolve);
     evolve(u0, u1, twiddle, dims[0], dims[1], dims[2]);
     if (timers_enabled) timer_stop(T_evolve);
+    // start powercap code
+    powercap_phase_end();
+    powercap_phase_begin(1);
+    // end powercap code
     if (timers_enabled) timer_start(T_fft);
     //fft(-1, u1, u2);
     fft(-1, u1, u1);
     if (timers_enabled) timer_stop(T_fft);
+    // start powercap code
+    powercap_phase_end();
+    // end powercap code
     if (timers_enabled) timer_start(T_checksum);
     //checksum(iter, u2, dims[0], dims[1], dims[2]);
     checksum(iter, u1, dims[0], dims[1], dims[2]);
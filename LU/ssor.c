@@ -163,6 +163,11 @@ void ssor(int niter)
     if (iam <= mthreadnum) isync[iam] = 0;
     #pragma omp barrier
 
+    // start powercap code
+    #pragma omp master
+    powercap_phase_begin(0);
+    // end powercap code
+
     for (k = 1; k < nz -1; k++) {
       //---------------------------------------------------------------------
       // form the lower triangular part of the jacobian matrix
@@ -190,6 +195,14 @@ void ssor(int niter)
       if (timeron) timer_stop(t_blts);
     }
     #pragma omp barrier
+
+    // start powercap code
+    #pragma omp master
+    {
+    powercap_phase_end();
+    powercap_phase_begin(1);
+    }
+    // end powercap code
  
     for (k = nz - 2; k > 0; k--) {
       //---------------------------------------------------------------------
@@ -219,6 +232,11 @@ void ssor(int niter)
     }
     #pragma omp barrier
 
+    // start powercap code
+    #pragma omp master
+    powercap_phase_end();
+    // end powercap code
+
     //---------------------------------------------------------------------
     // update the variables
     //---------------------------------------------------------------------
@@ -238,6 +256,10 @@ void ssor(int niter)
     } //end parallel
     if (timeron) timer_stop(t_add);
 
+    // start powercap code
+    powercap_phase_begin(2);
+    // end powercap code
+
     //---------------------------------------------------------------------
     // compute the max-norms of newton iteration corrections
     //---------------------------------------------------------------------
@@ -296,6 +318,10 @@ void ssor(int niter)
       */
     }
 
+    // start powercap code
+    powercap_phase_end();
+    // end powercap code
+
     //---------------------------------------------------------------------
     // check the newton-iteration residuals against the tolerance levels
     //---------------------------------------------------------------------
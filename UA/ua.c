@@ -368,9 +368,18 @@ int main(int argc, char *argv[])
       timer_start(1);
     }
 
+    // start powercap code
+    powercap_phase_begin(0);
+    // end powercap code
+
     // advance the convection step 
     convect(ifmortar);
 
+    // start powercap code
+    powercap_phase_end();
+    powercap_phase_begin(1);
+    // end powercap code
+
     if (timeron) timer_start(t_transf2);
     // prepare the intital guess for cg
     transf(tmort, (double *)ta1);
@@ -424,11 +433,21 @@ int main(int argc, char *argv[])
     add2((double *)ta1, (double *)t, ntot);
     if (timeron) timer_stop(t_add2);
 
+    // start powercap code
+    powercap_phase_end();
+    // end powercap code
+
     // perform mesh adaptation
     h_time = h_time + dtime;
     if ((step != 0) && (step/fre*fre == step)) {
       if (step != niter) {
+        // start powercap code
+        powercap_phase_begin(2);
+        // end powercap code
         adaptation(&ifmortar, step);
+        // start powercap code
+        powercap_phase_end();
+        // end powercap code
       }
     } else {
       ifmortar = false;
@@ -0,0 +1,61 @@
+import argparse, os, struct, sys
+
+# Creates and drives a tree of regular files that replaces /dev/cpu/N/msr for the MSR backend (POWER_BACKEND=1).
+# Each file is sparse and the value of a register is stored at the offset equal to its address, as read by pread/pwrite.
+
+MSR_RAPL_POWER_UNIT = 0x606
+MSR_PKG_ENERGY_STATUS = 0x611
+MSR_DRAM_ENERGY_STATUS = 0x619
+MSR_PP0_ENERGY_STATUS = 0x639
+IA32_PERF_CTL = 0x199
+
+def msr_path(root, cpu):
+	return os.path.join(root, "cpu", str(cpu), "msr")
+
+def read_msr(root, cpu, msr):
+	with open(msr_path(root, cpu), "rb") as f:
+		f.seek(msr)
+		data = f.read(8)
+	if len(data) < 8:
+		return 0
+	return struct.unpack("<Q", data)[0]
+
+def write_msr(root, cpu, msr, value):
+	with open(msr_path(root, cpu), "r+b") as f:
+		f.seek(msr)
+		f.write(struct.pack("<Q", value))
+
+def main(argv):
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument('command', choices=['create', 'advance', 'status'])
+	parser.add_argument('-root', dest='root', required=True)
+	parser.add_argument('-cores', dest='cores', type=int, default=1)
+	parser.add_argument('-esu', dest='esu', type=int, default=14)		# Energy status unit, energy is counted in units of 1/2^esu Joule
+	parser.add_argument('-cpu', dest='cpu', type=int, default=0)		# First core of the package whose counters are advanced
+	parser.add_argument('-package_joules', dest='pkg', type=float, default=0)
+	parser.add_argument('-core_joules', dest='core', type=float, default=0)
+	parser.add_argument('-dram_joules', dest='dram', type=float, default=0)
+	args = parser.parse_args(argv)
+
+	if args.command == 'create':
+		for cpu in range(args.cores):
+			if not os.path.isdir(os.path.dirname(msr_path(args.root, cpu))):
+				os.makedirs(os.path.dirname(msr_path(args.root, cpu)))
+			open(msr_path(args.root, cpu), "wb").close()
+			write_msr(args.root, cpu, MSR_RAPL_POWER_UNIT, (args.esu & 0x1f) << 8)
+		print("Created fake msr devices for " + str(args.cores) + " cores in " + args.root)
+
+	elif args.command == 'advance':
+		unit = 1.0 / (1 << ((read_msr(args.root, args.cpu, MSR_RAPL_POWER_UNIT) >> 8) & 0x1f))
+		for msr, joules in ((MSR_PKG_ENERGY_STATUS, args.pkg), (MSR_PP0_ENERGY_STATUS, args.core), (MSR_DRAM_ENERGY_STATUS, args.dram)):
+			value = (read_msr(args.root, args.cpu, msr) + int(joules / unit)) & 0xffffffff
+			write_msr(args.root, args.cpu, msr, value)
+
+	else:
+		print("IA32_PERF_CTL ratio of cpu " + str(args.cpu) + ": " + str((read_msr(args.root, args.cpu, IA32_PERF_CTL) >> 8) & 0xff))
+		print("MSR_PKG_ENERGY_STATUS of cpu " + str(args.cpu) + ": " + str(read_msr(args.root, args.cpu, MSR_PKG_ENERGY_STATUS)))
+
+
+if __name__ == "__main__":
+   main(sys.argv[1:])
@@ -11,8 +11,10 @@ def main(argv):
 	        name, var = line.partition("=")[::2] #remove the = 
 	        name = name.strip()
 	        if var != "":
-		        if name == "POWER_LIMIT" or name == "POWER_UNCORE" or name == "EXTRA_RANGE_PERCENTAGE" :
+		        if name == "POWER_LIMIT" or name == "POWER_UNCORE" or name == "EXTRA_RANGE_PERCENTAGE" or name == "UNCORE_TOLERANCE" or name == "ROUND_DURATION" or name == "ROUND_CONFIDENCE" or name == "MODEL_FORGETTING" or name.startswith("CHANGE_") or name.startswith("SIM_") or name == "PHASE_SAMPLE_TIME" or name == "DUTY_PERIOD" or name == "NODE_BUDGET" or name == "NODE_PERIOD" or name == "ENERGY_BUDGET" :
 		        	myvars[name] = float(var)
+		        elif name == "SYSFS_ROOT" or name == "MSR_ROOT" or name == "CACHE_DIR" or name == "CONTROL_SOCKET" or name == "NODE_FILE" or name == "TRACE_FILE" :
+		        	myvars[name] = var.strip()
 		        else:
 		        	myvars[name] = int(var)
 
@@ -26,6 +28,18 @@ def main(argv):
 	parser.add_argument('-power_uncore', dest='pu')
 	parser.add_argument('-core_packing', dest='cp')
 	parser.add_argument('-window_size', dest='w')
+	parser.add_argument('-sysfs_root', dest='sr')
+	parser.add_argument('-hw_power_limit', dest='hw')
+	parser.add_argument('-round_duration', dest='rd')
+	parser.add_argument('-power_backend', dest='pb')
+	parser.add_argument('-phase_aware', dest='pa')
+	parser.add_argument('-config_cache', dest='cc')
+	parser.add_argument('-duty_cycling', dest='dc')
+	parser.add_argument('-control_socket', dest='cs')
+	parser.add_argument('-node_budget', dest='nb')
+	parser.add_argument('-objective', dest='o')
+	parser.add_argument('-energy_budget', dest='eb')
+	parser.add_argument('-trace_file', dest='tf')
 	args = parser.parse_args()
 
 	# Set myvars based on commnad line parameters 
@@ -61,6 +75,54 @@ def main(argv):
 		myvars["WINDOW_SIZE"] = int(args.w)
 		print "Setting WINDOW_SIZE to " + args.w
 
+	if not (args.sr is None):
+		myvars["SYSFS_ROOT"] = args.sr
+		print "Setting SYSFS_ROOT to " + args.sr
+
+	if not (args.hw is None):
+		myvars["HW_POWER_LIMIT"] = int(args.hw)
+		print "Setting HW_POWER_LIMIT to " + args.hw
+
+	if not (args.rd is None):
+		myvars["ROUND_DURATION"] = float(args.rd)
+		print "Setting ROUND_DURATION to " + args.rd
+
+	if not (args.pb is None):
+		myvars["POWER_BACKEND"] = int(args.pb)
+		print "Setting POWER_BACKEND to " + args.pb
+
+	if not (args.pa is None):
+		myvars["PHASE_AWARE"] = int(args.pa)
+		print "Setting PHASE_AWARE to " + args.pa
+
+	if not (args.cc is None):
+		myvars["CONFIG_CACHE"] = int(args.cc)
+		print "Setting CONFIG_CACHE to " + args.cc
+
+	if not (args.dc is None):
+		myvars["DUTY_CYCLING"] = int(args.dc)
+		print "Setting DUTY_CYCLING to " + args.dc
+
+	if not (args.cs is None):
+		myvars["CONTROL_SOCKET"] = args.cs
+		print "Setting CONTROL_SOCKET to " + args.cs
+
+	if not (args.nb is None):
+		myvars["NODE_BUDGET"] = float(args.nb)
+		print "Setting NODE_BUDGET to " + args.nb
+
+	if not (args.o is None):
+		myvars["OBJECTIVE"] = int(args.o)
+		print "Setting OBJECTIVE to " + args.o
+
+	if not (args.eb is None):
+		myvars["ENERGY_BUDGET"] = float(args.eb)
+		print "Setting ENERGY_BUDGET to " + args.eb
+
+	if not (args.tf is None):
+		myvars["TRACE_FILE"] = args.tf
+		print "Setting TRACE_FILE to " + args.tf
+
 	with open("powercap_config.txt", 'w') as writeFile:
 		for key, value in myvars.items():
 			writeFile.write(str(key)+"="+str(value)+"\n")
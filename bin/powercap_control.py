@@ -0,0 +1,34 @@
+import argparse, socket, sys
+
+# Sends a command to the control socket of a running benchmark (CONTROL_SOCKET in powercap_config.txt) and prints the reply.
+# Commands: STATUS, POWER_LIMIT <watts>, HEURISTIC <mode>
+
+def send_command(path, command):
+	s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+	s.connect(path)
+	s.sendall((command + "\n").encode())
+	reply = b""
+	while True:
+		data = s.recv(256)
+		if not data:
+			break
+		reply += data
+	s.close()
+	return reply.decode().strip()
+
+def main(argv):
+
+	parser = argparse.ArgumentParser()
+	parser.add_argument('-socket', dest='socket', required=True)
+	parser.add_argument('-power_limit', dest='pl')
+	parser.add_argument('-heuristic_mode', dest='hm')
+	args = parser.parse_args()
+
+	if not (args.pl is None):
+		print(send_command(args.socket, "POWER_LIMIT " + args.pl))
+	if not (args.hm is None):
+		print(send_command(args.socket, "HEURISTIC " + args.hm))
+	print(send_command(args.socket, "STATUS"))
+
+if __name__ == "__main__":
+	main(sys.argv[1:])
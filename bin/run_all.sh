@@ -3,16 +3,21 @@ ITERATIONS=2
 OMP_THREADS=21
 
 APPS="bt.B.x cg.B.x ft.A.x lu.B.x sp.B.x mg.C.x is.C.x ua.B.x"
-
+DETECTION_MODES="2 4"		# Periodic exploration and Thompson sampling exploitation, stats of the latter go to files ending with -ts
 
 
 export OMP_NUM_THREADS=$OMP_THREADS
-for app in $APPS
-do	
-	for b in $(seq 1 $ITERATIONS)	
+for detection in $DETECTION_MODES
+do
+	python powercap_config_writer.py -detection_mode $detection
+
+	for app in $APPS
 	do	
-		echo "Running $app iteration $b..."
-		./$app
+		for b in $(seq 1 $ITERATIONS)	
+		do	
+			echo "Running $app iteration $b..."
+			./$app
+		done
+		echo "All $app runs completed."
 	done
-	echo "All $app runs completed."
 done
@@ -3,6 +3,8 @@ ITERATIONS=1
 OMP_THREADS=21
 
 MODES="10 11 12 15"
+HW_MODES="0 1"		# Software control only and hybrid control with the RAPL hardware limit, stats of the latter go to files ending with -hw
+DUTY_MODES="0 1"	# Exploitation by fluctuation and by duty cycling between two p-states, stats of the latter go to files ending with -dc
 CAPS="45 50 60 70 75"
 APPS="bt.B.x cg.B.x ft.A.x is.C.x mg.C.x sp.B.x lu.B.x"
 
@@ -12,17 +14,27 @@ for cap in $CAPS
 do
 	python powercap_config_writer.py -power_limit $cap
 
-	for mode in $MODES
+	for hw in $HW_MODES
 	do
-		python powercap_config_writer.py -heuristic_mode $mode
-		for app in $APPS
+		python powercap_config_writer.py -hw_power_limit $hw
+
+		for dc in $DUTY_MODES
 		do
-		        for b in $(seq 1 $ITERATIONS)   
-		        do
-		                echo "Running $app iteration $b..."
-		                ./$app
-		        done
-		        echo "All $app runs completed."
+			python powercap_config_writer.py -duty_cycling $dc
+
+			for mode in $MODES
+			do
+				python powercap_config_writer.py -heuristic_mode $mode
+				for app in $APPS
+				do
+				        for b in $(seq 1 $ITERATIONS)   
+				        do
+				                echo "Running $app iteration $b..."
+				                ./$app
+				        done
+				        echo "All $app runs completed."
+				done
+			done
 		done
 	done
 done 
\ No newline at end of file
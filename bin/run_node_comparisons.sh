@@ -0,0 +1,35 @@
+#!/bin/bash
+ITERATIONS=1
+OMP_THREADS=10
+
+# Co-schedules pairs of applications on the node, first with a static split of the budget and then sharing it with NODE_BUDGET
+# The runs that share the budget write their stats to files ending with -nb, their Net_throughput against the static split gives the gain
+MODES="10 15 18"
+BUDGETS="90 110 130"
+PAIRS="cg.B.x:mg.C.x ft.A.x:sp.B.x"
+
+export OMP_NUM_THREADS=$OMP_THREADS
+
+for budget in $BUDGETS
+do
+	for shared in 0 1
+	do
+		python powercap_config_writer.py -power_limit $(($budget/2)) -node_budget $(($budget*$shared))
+
+		for mode in $MODES
+		do
+			python powercap_config_writer.py -heuristic_mode $mode
+			for pair in $PAIRS
+			do
+				for b in $(seq 1 $ITERATIONS)
+				do
+					echo "Running ${pair/:/ and } iteration $b..."
+					./${pair%:*} &
+					./${pair#*:}
+					wait
+				done
+			done
+		done
+	done
+done
+python powercap_config_writer.py -node_budget 0
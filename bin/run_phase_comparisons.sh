@@ -0,0 +1,36 @@
+#!/bin/bash
+ITERATIONS=1
+OMP_THREADS=21
+
+# Compares the heuristics with the configuration learned per phase on the applications that mark their phases
+# Net_throughput at the same cap of the files ending with -ph against the others gives the gain of the phase-aware configurations
+MODES="10 12 15"
+PHASE_MODES="0 1"
+CAPS="45 50 60 70 75"
+APPS="ft.A.x lu.B.x ua.B.x"
+
+export OMP_NUM_THREADS=$OMP_THREADS
+
+for cap in $CAPS 
+do
+	python powercap_config_writer.py -power_limit $cap
+
+	for ph in $PHASE_MODES
+	do
+		python powercap_config_writer.py -phase_aware $ph
+
+		for mode in $MODES
+		do
+			python powercap_config_writer.py -heuristic_mode $mode
+			for app in $APPS
+			do
+			        for b in $(seq 1 $ITERATIONS)   
+			        do
+			                echo "Running $app iteration $b..."
+			                ./$app
+			        done
+			        echo "All $app runs completed."
+			done
+		done
+	done
+done 
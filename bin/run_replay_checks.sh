@@ -0,0 +1,94 @@
+#!/bin/bash
+ROUNDS=1000000
+REPLAY=$(pwd)/replay.x
+
+# Checks of the heuristics replayed on a synthetic surface by replay.x (make replay), without running the applications
+# The checks run on a copy of powercap_config.txt, print PASS or FAIL and the exit status is the number of failed checks
+# A check fails when replay.x fails, so a missing or broken replay.x cannot pass the checks
+FAILED=0
+
+if [ ! -x "$REPLAY" ]
+then
+	echo "FAIL: $REPLAY not found, build it with make replay"
+	exit 1
+fi
+
+if [ ! -f powercap_config.txt ]
+then
+	echo "FAIL: powercap_config.txt not found, run the checks from bin"
+	exit 1
+fi
+
+CHECK_DIR=$(mktemp -d)
+cp powercap_config.txt $CHECK_DIR
+
+set_config(){
+	sed -i "s|^$1=.*|$1=$2|" $CHECK_DIR/powercap_config.txt
+}
+
+# Runs replay.x with the given arguments and prints the value of a field for each heuristic
+# Returns a non-zero status, with the output of replay.x on stderr, when replay.x fails
+replay_field(){
+	field=$1
+	shift
+	if ! output=$(cd $CHECK_DIR && $REPLAY -synthetic "$@" 2>&1)
+	then
+		echo "replay.x -synthetic $* failed:" >&2
+		echo "$output" >&2
+		return 1
+	fi
+	echo "$output" | awk -v field="$field:" '$1 == "Heuristic:" { for(i = 1; i < NF; i++) if($i == field) print $(i+1) }'
+}
+
+# Prints PASS if replay_field returned the status 0 and the expected number of values, none of which matches the awk
+# condition, FAIL otherwise
+# Arguments: description, status of replay_field, values, awk condition of a failing value, expected number of values
+check_values(){
+	if [ "$2" != "0" ]
+	then
+		echo "FAIL: $1 (replay.x failed)"
+		FAILED=$((FAILED+1))
+		return
+	fi
+
+	values=$(echo "$3" | awk 'NF' | wc -l)
+	if [ "$values" != "$5" ]
+	then
+		echo "FAIL: $1 ($values values instead of $5)"
+		FAILED=$((FAILED+1))
+		return
+	fi
+
+	failing=$(echo "$3" | awk "NF && ($4)" | wc -l)
+	if [ "$failing" != "0" ]
+	then
+		echo "FAIL: $1 ($failing failing values)"
+		FAILED=$((FAILED+1))
+		return
+	fi
+
+	echo "PASS: $1"
+}
+
+# The online models stay finite, one value for each of heuristics 15 and 18, while they exploit a single configuration with forgetting
+set_config MODEL_FORGETTING 0.98
+set_config SIM_NOISE 2
+finite=$(replay_field Model_finite -heuristic_modes 15,18 -detection_mode 0 -rounds $ROUNDS -power_limit 12)
+check_values "online models finite after $ROUNDS rounds of exploitation with forgetting 0.98" $? "$finite" '$1 != 1' 2
+set_config MODEL_FORGETTING 1
+
+# Detection mode 5 does not restart the exploration on a stationary surface with noise for any of the heuristics, including
+# the ones whose fluctuation moves the best configuration
+explorations=$(replay_field Explorations -heuristic_modes 9,10,11,12,13,14,15,16,17,18 -detection_mode 5 -rounds 200000 -power_limit 12)
+check_values "detection mode 5 explores once on a stationary surface" $? "$explorations" '$1 > 1' 10
+
+# Detection mode 5 restarts the exploration of each of heuristics 9, 11, 14 and 17 on synthetic phase changes that scale
+# the power by 1.5 every 20 seconds
+set_config SIM_PHASE_PERIOD 20000
+set_config SIM_PHASE_SCALE 1.5
+explorations=$(replay_field Explorations -heuristic_modes 9,11,14,17 -detection_mode 5 -rounds 200000 -power_limit 12)
+check_values "detection mode 5 restarts the exploration on synthetic phase changes" $? "$explorations" '$1 < 10' 4
+set_config SIM_PHASE_PERIOD 0
+
+rm -rf $CHECK_DIR
+exit $FAILED
@@ -0,0 +1,92 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Power management backends
+///////////////////////////////////////////////////////////////
+
+// Backends are described by the operations in backend_t.h and selected at startup by init_backend()
+
+// Reads the package of each core from the topology and sets the number of packages
+static void discover_packages(){
+
+	char fname[512];
+	FILE* numafile;
+	int i;
+
+	nb_packages = 0;
+	core_package = malloc(sizeof(int)*nb_cores);
+
+	for(i = 0; i < nb_cores; i++){
+		sprintf(fname,"%s/devices/system/cpu/cpu%d/topology/physical_package_id", sysfs_root, i);
+		numafile = fopen(fname,"r");
+		if (numafile == NULL || fscanf(numafile ,"%d", &core_package[i]) != 1){
+			printf("Cannot read number of packages\n");
+			exit(1);
+		}
+		fclose(numafile);
+		if(core_package[i]+1 > nb_packages)
+			nb_packages = core_package[i]+1;
+	}
+}
+
+static void rapl_init(int threads){
+	discover_packages();
+	init_DVFS_management();
+	init_energy_management();
+}
+
+static void msr_init(int threads){
+	discover_packages();
+	init_DVFS_management_pstate_range();
+	init_msr_management();
+}
+
+static power_backend_t rapl_backend = {"rapl", rapl_init, rapl_get_energy, rapl_get_energy_core, rapl_get_energy_dram, sysfs_set_frequency, sysfs_set_core_frequency, schedule_threads};
+static power_backend_t msr_backend = {"msr", msr_init, msr_get_energy, msr_get_energy_core, msr_get_energy_dram, msr_set_frequency, msr_set_core_frequency, schedule_threads};
+static power_backend_t sim_backend = {"simulated", sim_init, sim_get_energy, sim_get_energy_subdomain, sim_get_energy_subdomain, sim_set_frequency, sim_set_core_frequency, sim_set_threads};
+
+// Selects the backend set with POWER_BACKEND in powercap_config.txt and initializes it
+void init_backend(int threads){
+
+	switch(power_backend){
+		case 0:
+			backend = &rapl_backend;
+			break;
+		case 1:
+			backend = &msr_backend;
+			break;
+		case 2:
+			backend = &sim_backend;
+			break;
+		default:
+			printf("Power backend invalid\n");
+			exit(1);
+	}
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Power backend: %s\n", backend->name);
+	#endif
+
+	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	packed_cores = nb_cores;
+	current_uncore_pstate = -1;		// Set later by init_uncore_management()
+	backend->init(threads);
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Number of packages detected: %d\n", nb_packages);
+	#endif
+}
+
+long get_energy(){
+	return backend->get_energy();
+}
+
+long get_energy_core(){
+	return backend->get_energy_core();
+}
+
+long get_energy_dram(){
+	return backend->get_energy_dram();
+}
@@ -0,0 +1,17 @@
+#ifndef BACKEND_T_POWERCAP
+#define BACKEND_T_POWERCAP
+
+// Operations provided by a power management backend. Each backend provides topology discovery, energy readings and the actuators
+// for frequency and threads. The rest of the runtime, including all the heuristics, only goes through get_energy(), set_pstate() and set_threads()
+typedef struct power_backend{
+    char* name;
+    void (*init)(int threads);              // Discovers nb_cores, nb_packages and the p-states, then sets the highest frequency
+    long (*get_energy)(void);               // Energy of all packages in micro Joule
+    long (*get_energy_core)(void);          // Energy of the cores of all packages in micro Joule, 0 if not available
+    long (*get_energy_dram)(void);          // Energy of the DRAM of all packages in micro Joule, 0 if not available
+    void (*set_frequency)(int frequency);   // Requests the frequency, expressed in KHz, to all cores
+    void (*set_core_frequency)(int core, int frequency);   // Requests the frequency, expressed in KHz, to a single core
+    void (*set_threads)(int threads);       // Schedules the given number of threads
+  } power_backend_t;
+
+  #endif
@@ -0,0 +1,177 @@
+#include "powercap.h"
+#include <stdlib.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Thompson sampling exploitation
+///////////////////////////////////////////////////////////////
+
+// Detection mode 4 replaces the fixed exploit/explore cycle of detection mode 2. After an exploration, the arms are the best configuration
+// and its neighbors with one thread or one p-state more or less. Each arm keeps a gaussian posterior of throughput and power, and each
+// round samples a value from all the posteriors and runs the arm with the highest sampled throughput among the ones with sampled power
+// within power_limit, or the one with the lowest sampled power if none is. Arms never run start from the posterior of the center with
+// a wide variance, so they are tried occasionally. When a neighbor is sampled enough and is better than the center within power_limit,
+// the neighborhood moves to it. Posteriors are discounted by BANDIT_DISCOUNT each round, so that they follow workload changes.
+
+#define BANDIT_ARMS 5				// Center and four neighbors
+#define BANDIT_DISCOUNT 0.95		// Weight of the past samples after each round
+#define BANDIT_PRIOR_STDDEV 0.2		// Relative standard deviation of the prior of an arm never run
+#define BANDIT_MIN_NOISE 0.02		// Minimum relative standard deviation of a single sample
+#define BANDIT_MOVE_SAMPLES 3		// Weight of samples required to move the neighborhood to a neighbor
+
+typedef struct bandit_arm{
+	int threads;
+	int pstate;
+	double weight;				// Discounted number of samples
+	double throughput;			// Discounted mean and variance of the samples
+	double throughput_var;
+	double power;
+	double power_var;
+} bandit_arm_t;
+
+// State of Thompson sampling of a controller
+typedef struct bandit_state{
+	bandit_arm_t arms[BANDIT_ARMS];
+	int nb_arms;
+	int current_arm;			// Arm of the configuration currently running, -1 before the first round after an exploration
+	unsigned int seed;
+} bandit_state_t;
+
+static bandit_state_t* bandit_state(){
+
+	if(ctl->bandit == NULL){
+		ctl->bandit = calloc(1, sizeof(bandit_state_t));
+		ctl->bandit->current_arm = -1;
+		ctl->bandit->seed = 12345;
+	}
+	return ctl->bandit;
+}
+
+// Standard normal value obtained with the Box-Muller transform
+static double bandit_gaussian(){
+
+	bandit_state_t* bandit = bandit_state();
+	double u1 = ((double) rand_r(&bandit->seed) + 1) / ((double) RAND_MAX + 2);
+	double u2 = ((double) rand_r(&bandit->seed) + 1) / ((double) RAND_MAX + 2);
+
+	return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
+
+static void bandit_add_arm(int threads, int input_pstate){
+
+	bandit_state_t* bandit = bandit_state();
+
+	if(threads < 1 || threads > total_threads || input_pstate < 0 || input_pstate > max_pstate)
+		return;
+
+	bandit->arms[bandit->nb_arms].threads = threads;
+	bandit->arms[bandit->nb_arms].pstate = input_pstate;
+	bandit->arms[bandit->nb_arms].weight = 0;
+	bandit->nb_arms++;
+}
+
+// Sets the neighborhood around the given configuration. The center keeps its posterior
+static void bandit_center(int threads, int input_pstate, bandit_arm_t* center_posterior){
+
+	bandit_state_t* bandit = bandit_state();
+
+	bandit->nb_arms = 0;
+	bandit_add_arm(threads, input_pstate);
+	if(center_posterior != NULL)
+		bandit->arms[0] = *center_posterior;
+	bandit_add_arm(threads-1, input_pstate);
+	bandit_add_arm(threads+1, input_pstate);
+	bandit_add_arm(threads, input_pstate-1);
+	bandit_add_arm(threads, input_pstate+1);
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Thompson sampling centered on %d threads - p-state %d - %d arms\n", threads, input_pstate, bandit->nb_arms);
+	#endif
+}
+
+static void bandit_update_arm(bandit_arm_t* arm, double throughput, double power){
+
+	double delta;
+
+	arm->weight += 1;
+
+	delta = throughput - arm->throughput;
+	arm->throughput += delta/arm->weight;
+	arm->throughput_var += (delta*(throughput - arm->throughput) - arm->throughput_var)/arm->weight;
+
+	delta = power - arm->power;
+	arm->power += delta/arm->weight;
+	arm->power_var += (delta*(power - arm->power) - arm->power_var)/arm->weight;
+}
+
+// Draws a value from the posterior of the mean, with the noise of a single sample bounded from below
+static double bandit_draw(double mean, double variance, double weight){
+
+	double stddev = sqrt(variance);
+
+	if(stddev < BANDIT_MIN_NOISE*mean)
+		stddev = BANDIT_MIN_NOISE*mean;
+
+	return mean + bandit_gaussian()*stddev/sqrt(weight);
+}
+
+void bandit_exploit(double throughput, double power){
+
+	bandit_state_t* bandit = bandit_state();
+	double sampled_throughput, sampled_power, best_sampled = -1, lowest_power = -1;
+	int i, chosen = -1, lowest = 0;
+
+	// First round after an exploration, the best configuration is running
+	if(bandit->current_arm == -1){
+		bandit_center(ctl->active_threads, ctl->current_pstate, NULL);
+		bandit->current_arm = 0;
+	}
+
+	for(i = 0; i < bandit->nb_arms; i++)
+		bandit->arms[i].weight *= BANDIT_DISCOUNT;
+	bandit_update_arm(&bandit->arms[bandit->current_arm], throughput, power);
+	if(bandit->current_arm != 0)
+		ctl->bandit_neighbor_rounds++;
+
+	// Moves the neighborhood if a neighbor is better than the center within power_limit
+	if(bandit->current_arm != 0 && bandit->arms[bandit->current_arm].weight >= BANDIT_MOVE_SAMPLES && bandit->arms[bandit->current_arm].power <= ctl->power_limit
+			&& (bandit->arms[bandit->current_arm].throughput > bandit->arms[0].throughput || bandit->arms[0].power > ctl->power_limit)){
+		bandit_arm_t moved = bandit->arms[bandit->current_arm];
+		bandit_center(moved.threads, moved.pstate, &moved);
+		bandit->current_arm = 0;
+		ctl->bandit_moves++;
+	}
+
+	for(i = 0; i < bandit->nb_arms; i++){
+		if(bandit->arms[i].weight > 0.01){
+			sampled_throughput = bandit_draw(bandit->arms[i].throughput, bandit->arms[i].throughput_var, bandit->arms[i].weight);
+			sampled_power = bandit_draw(bandit->arms[i].power, bandit->arms[i].power_var, bandit->arms[i].weight);
+		}else{
+			sampled_throughput = bandit->arms[0].throughput*(1 + BANDIT_PRIOR_STDDEV*bandit_gaussian());
+			sampled_power = bandit->arms[0].power*(1 + BANDIT_PRIOR_STDDEV*bandit_gaussian());
+		}
+
+		if(sampled_power <= ctl->power_limit && sampled_throughput > best_sampled){
+			best_sampled = sampled_throughput;
+			chosen = i;
+		}
+		if(lowest_power < 0 || sampled_power < lowest_power){
+			lowest_power = sampled_power;
+			lowest = i;
+		}
+	}
+
+	if(chosen == -1)
+		chosen = lowest;
+
+	bandit->current_arm = chosen;
+	set_pstate(bandit->arms[chosen].pstate);
+	set_threads(bandit->arms[chosen].threads);
+}
+
+// Called when an exploration restarts, the next exploitation builds a new neighborhood
+void bandit_reset(){
+	if(ctl->bandit != NULL)
+		ctl->bandit->current_arm = -1;
+}
@@ -0,0 +1,262 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Bayesian optimization heuristic
+///////////////////////////////////////////////////////////////
+
+// Heuristic 17 models throughput and power over the grid of threads and p-states with two gaussian processes, with squared
+// exponential kernel over the coordinates normalized to [0,1]. After an initial design of three configurations, each round
+// samples the configuration that maximizes the expected improvement of throughput multiplied by the probability that its power
+// is lower than power_limit. If no sampled configuration is within power_limit yet, the probability alone is maximized.
+// The exploration stops when the best acquisition is lower than BO_MIN_IMPROVEMENT of the best throughput or after
+// BO_MAX_SAMPLES rounds, and sets the best sampled configuration within power_limit. Unlike the hill climbing heuristics,
+// it does not assume throughput to be monotonic with the number of threads.
+
+#define BO_MAX_SAMPLES 24			// Maximum number of rounds of an exploration
+#define BO_LENGTH_SCALE 0.3			// Length scale of the kernel, the coordinates are normalized to [0,1]
+#define BO_NOISE 0.01				// Variance of the noise of the normalized samples
+#define BO_MIN_IMPROVEMENT 0.005	// Expected improvement, relative to the best throughput, below which the exploration stops
+
+typedef struct gaussian_process{
+	double l[BO_MAX_SAMPLES][BO_MAX_SAMPLES];	// Cholesky factor of the kernel matrix
+	double alpha[BO_MAX_SAMPLES];				// Kernel matrix inverse times the centered samples
+	double mean;								// Mean of the samples, used as prior mean
+} gaussian_process_t;
+
+// State of heuristic 17 of a controller
+typedef struct bo_state{
+	double x[BO_MAX_SAMPLES][2];			// Normalized coordinates of the sampled configurations
+	int threads[BO_MAX_SAMPLES];
+	int pstate[BO_MAX_SAMPLES];
+	double throughput[BO_MAX_SAMPLES];
+	double power[BO_MAX_SAMPLES];
+	int samples;
+	int completed;							// Set when the exploration stops, the next call starts a new one
+	gaussian_process_t throughput_gp;
+	gaussian_process_t power_gp;
+} bo_state_t;
+
+static double bo_coordinate_threads(int threads){
+	return total_threads > 1 ? ((double) (threads-1))/(total_threads-1) : 0;
+}
+
+static double bo_coordinate_pstate(int input_pstate){
+	return max_pstate > 0 ? ((double) input_pstate)/max_pstate : 0;
+}
+
+static double bo_kernel(double* x, double* y){
+
+	double d0 = x[0] - y[0], d1 = x[1] - y[1];
+
+	return exp(-(d0*d0 + d1*d1)/(2*BO_LENGTH_SCALE*BO_LENGTH_SCALE));
+}
+
+// Fits the gaussian process to the given samples, normalized by scale
+static void gp_fit(gaussian_process_t* gp, double* samples, double scale){
+
+	bo_state_t* bo = ctl->bo;
+	double z[BO_MAX_SAMPLES], sum;
+	int i, j, k;
+
+	gp->mean = 0;
+	for(i = 0; i < bo->samples; i++)
+		gp->mean += samples[i]/scale;
+	gp->mean /= bo->samples;
+
+	// Cholesky decomposition of K + noise*I
+	for(i = 0; i < bo->samples; i++){
+		for(j = 0; j <= i; j++){
+			sum = bo_kernel(bo->x[i], bo->x[j]) + (i == j ? BO_NOISE : 0);
+			for(k = 0; k < j; k++)
+				sum -= gp->l[i][k]*gp->l[j][k];
+			if(i == j)
+				gp->l[i][i] = sqrt(sum > 1e-12 ? sum : 1e-12);
+			else
+				gp->l[i][j] = sum/gp->l[j][j];
+		}
+	}
+
+	// alpha = L^-T L^-1 (y - mean)
+	for(i = 0; i < bo->samples; i++){
+		sum = samples[i]/scale - gp->mean;
+		for(k = 0; k < i; k++)
+			sum -= gp->l[i][k]*z[k];
+		z[i] = sum/gp->l[i][i];
+	}
+	for(i = bo->samples-1; i >= 0; i--){
+		sum = z[i];
+		for(k = i+1; k < bo->samples; k++)
+			sum -= gp->l[k][i]*gp->alpha[k];
+		gp->alpha[i] = sum/gp->l[i][i];
+	}
+}
+
+// Computes the posterior mean and standard deviation at x
+static void gp_predict(gaussian_process_t* gp, double* x, double* mean, double* stddev){
+
+	bo_state_t* bo = ctl->bo;
+	double kx[BO_MAX_SAMPLES], v[BO_MAX_SAMPLES], sum, variance = 1;
+	int i, k;
+
+	*mean = gp->mean;
+	for(i = 0; i < bo->samples; i++){
+		kx[i] = bo_kernel(x, bo->x[i]);
+		*mean += kx[i]*gp->alpha[i];
+	}
+
+	for(i = 0; i < bo->samples; i++){
+		sum = kx[i];
+		for(k = 0; k < i; k++)
+			sum -= gp->l[i][k]*v[k];
+		v[i] = sum/gp->l[i][i];
+		variance -= v[i]*v[i];
+	}
+
+	*stddev = sqrt(variance > 1e-12 ? variance : 1e-12);
+}
+
+static double normal_pdf(double z){
+	return exp(-z*z/2)/sqrt(2*M_PI);
+}
+
+static double normal_cdf(double z){
+	return 0.5*erfc(-z/sqrt(2));
+}
+
+static int bo_sampled(int threads, int input_pstate){
+
+	bo_state_t* bo = ctl->bo;
+	int i;
+
+	for(i = 0; i < bo->samples; i++){
+		if(bo->threads[i] == threads && bo->pstate[i] == input_pstate)
+			return 1;
+	}
+	return 0;
+}
+
+// Best sampled configuration within power_limit, -1 if none
+static int bo_best_feasible(){
+
+	bo_state_t* bo = ctl->bo;
+	int i, best = -1;
+
+	for(i = 0; i < bo->samples; i++){
+		if(bo->power[i] <= ctl->power_limit && (best == -1 || bo->throughput[i] > bo->throughput[best]))
+			best = i;
+	}
+	return best;
+}
+
+static void bo_stop(){
+
+	bo_state_t* bo = ctl->bo;
+	int best = bo_best_feasible();
+
+	if(best >= 0){
+		ctl->best_threads = bo->threads[best];
+		ctl->best_pstate = bo->pstate[best];
+		ctl->best_throughput = bo->throughput[best];
+		ctl->best_power = bo->power[best];
+	}else{
+		ctl->best_threads = 1;
+		ctl->best_pstate = max_pstate;
+		ctl->best_throughput = -1;
+	}
+
+	bo->completed = 1;
+	stop_searching();
+}
+
+void heuristic_bayesian(double throughput, double power){
+
+	bo_state_t* bo;
+	double x[2], scale = 0, mean, stddev, power_mean, power_stddev, z, acquisition, best_acquisition = -1, incumbent = 0;
+	int i, j, best = -1, next_threads = -1, next_pstate = -1;
+
+	if(ctl->bo == NULL){
+		ctl->bo = calloc(1, sizeof(bo_state_t));
+		ctl->bo->completed = 1;
+	}
+	bo = ctl->bo;
+
+	if(bo->completed){
+		bo->samples = 0;
+		bo->completed = 0;
+	}
+
+	bo->threads[bo->samples] = ctl->active_threads;
+	bo->pstate[bo->samples] = ctl->current_pstate;
+	bo->x[bo->samples][0] = bo_coordinate_threads(ctl->active_threads);
+	bo->x[bo->samples][1] = bo_coordinate_pstate(ctl->current_pstate);
+	bo->throughput[bo->samples] = throughput;
+	bo->power[bo->samples] = power;
+	bo->samples++;
+
+	// Initial design: lowest power configuration, then all threads at the lowest frequency and a central configuration
+	if(bo->samples == 1 && !bo_sampled(total_threads, max_pstate)){
+		set_pstate(max_pstate);
+		set_threads(total_threads);
+		return;
+	}
+	if(bo->samples == 2 && !bo_sampled((total_threads+1)/2, max_pstate/2)){
+		set_pstate(max_pstate/2);
+		set_threads((total_threads+1)/2);
+		return;
+	}
+
+	if(bo->samples >= BO_MAX_SAMPLES || bo->samples >= (max_pstate+1)*total_threads){
+		bo_stop();
+		return;
+	}
+
+	for(i = 0; i < bo->samples; i++){
+		if(bo->throughput[i] > scale)
+			scale = bo->throughput[i];
+	}
+	gp_fit(&bo->throughput_gp, bo->throughput, scale);
+	gp_fit(&bo->power_gp, bo->power, ctl->power_limit);
+
+	best = bo_best_feasible();
+	if(best >= 0)
+		incumbent = bo->throughput[best]/scale;
+
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			if(bo_sampled(j, i))
+				continue;
+
+			x[0] = bo_coordinate_threads(j);
+			x[1] = bo_coordinate_pstate(i);
+			gp_predict(&bo->power_gp, x, &power_mean, &power_stddev);
+			acquisition = normal_cdf((1 - power_mean)/power_stddev);
+
+			// Constrained expected improvement
+			if(best >= 0){
+				gp_predict(&bo->throughput_gp, x, &mean, &stddev);
+				z = (mean - incumbent)/stddev;
+				acquisition *= (mean - incumbent)*normal_cdf(z) + stddev*normal_pdf(z);
+			}
+
+			if(acquisition > best_acquisition){
+				best_acquisition = acquisition;
+				next_threads = j;
+				next_pstate = i;
+			}
+		}
+	}
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Bayesian optimization - %d samples - best acquisition %lf at %d threads p-state %d\n", bo->samples, best_acquisition, next_threads, next_pstate);
+	#endif
+
+	if(next_threads == -1 || (best >= 0 && best_acquisition < BO_MIN_IMPROVEMENT*incumbent)){
+		bo_stop();
+		return;
+	}
+
+	set_pstate(next_pstate);
+	set_threads(next_threads);
+}
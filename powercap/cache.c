@@ -0,0 +1,168 @@
+#include "powercap.h"
+#include <stdlib.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Configuration cache
+///////////////////////////////////////////////////////////////
+
+// With config_cache, the configurations measured by a run are saved in cache_dir at powercap_print_stats() and loaded by the next
+// run of the same application. Files are keyed by program name, which includes the class, number of threads, power limit,
+// machine topology, power backend and objective. A file holds the best configuration of the last run, with its uncore p-state, and the
+// mean throughput and power of each configuration sampled by this and the previous runs, as accumulated by pareto.c.
+// At the end of the ramp up a cached best configuration replaces the exploration, which starts only when the detection mode
+// restarts it or when the first step exceeds the power limit by more than extra_range_percentage. The sampled configurations
+// also warm start the online models of heuristics 15 and 18, the latter never stops searching so it is not warm started otherwise.
+
+static int cache_best_threads = -1;		// Best configuration loaded from the cache, -1 if none
+static int cache_best_pstate;
+static double cache_best_throughput;
+static double cache_best_power;
+static int cache_best_uncore_pstate;
+static int cache_checking;				// 1 until the first step at the cached configuration is checked against power_limit
+
+static void config_cache_file_name(char* file_name){
+
+	extern char *__progname;
+
+	sprintf(file_name, "%s/%s-%dt-%gw-%dp%dc%ds%d-b%d-o%d-%gj.cache", cache_dir, __progname, nas_total_threads, ctl->power_limit,
+		nb_packages, nb_cores, max_pstate+1, pstate[0]/1000, power_backend, ctl->objective, ctl->energy_budget);
+}
+
+// Executed inside powercap_init(), after the online models and the sampled configurations are initialized
+void load_config_cache(){
+
+	char file_name[512];
+	FILE* cache_file;
+	int threads, input_pstate;
+	double weight, throughput, power;
+
+	if(!config_cache)
+		return;
+
+	config_cache_file_name(file_name);
+	if((cache_file = fopen(file_name, "r")) == NULL){
+		#ifdef DEBUG_HEURISTICS
+			printf("No configuration cache in %s\n", file_name);
+		#endif
+		return;
+	}
+
+	if(fscanf(cache_file, "BEST_THREADS=%d BEST_PSTATE=%d BEST_THROUGHPUT=%lf BEST_POWER=%lf BEST_UNCORE_PSTATE=%d",
+			&cache_best_threads, &cache_best_pstate, &cache_best_throughput, &cache_best_power, &cache_best_uncore_pstate) != 5){
+		printf("Configuration cache %s is malformed, ignoring it\n", file_name);
+		cache_best_threads = -1;
+		fclose(cache_file);
+		return;
+	}
+
+	if(cache_best_threads > total_threads || cache_best_pstate < 0 || cache_best_pstate > max_pstate || cache_best_uncore_pstate > max_uncore_pstate)
+		cache_best_threads = -1;
+
+	while(fscanf(cache_file, "%d %d %lf %lf %lf", &input_pstate, &threads, &weight, &throughput, &power) == 5){
+		if(input_pstate < 0 || input_pstate > max_pstate || threads < 1 || threads > total_threads || weight <= 0)
+			continue;
+
+		pareto_load_sample(input_pstate, threads, weight, throughput, power);
+
+		if(ctl->heuristic_mode == 15 || ctl->heuristic_mode == 18)
+			model_add_sample(input_pstate, threads, throughput, power);
+	}
+
+	fclose(cache_file);
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Configuration cache loaded from %s - best %d threads - p-state %d\n", file_name, cache_best_threads, cache_best_pstate);
+	#endif
+}
+
+// Called at the end of the ramp up. Returns 1 if the exploration was replaced by the cached best configuration
+int config_cache_warm_start(){
+
+	if(!config_cache || cache_best_threads < 1 || ctl->heuristic_mode == 8 || ctl->heuristic_mode == 18 || ctl->detection_mode == 3)
+		return 0;
+
+	ctl->best_threads = cache_best_threads;
+	ctl->best_pstate = cache_best_pstate;
+	ctl->best_throughput = cache_best_throughput;
+	ctl->best_power = cache_best_power;
+	stop_searching();
+
+	if(uncore_searching && cache_best_uncore_pstate >= 0){
+		uncore_searching = 0;
+		best_uncore_pstate = cache_best_uncore_pstate;
+		set_uncore_pstate(best_uncore_pstate);
+	}
+
+	cache_checking = 1;
+	cache_warm_started = 1;
+
+	#ifdef DEBUG_HEURISTICS
+		printf("WARM START FROM THE CONFIGURATION CACHE: #threads %d - p_state %d\n", ctl->best_threads, ctl->best_pstate);
+	#endif
+
+	return 1;
+}
+
+// Returns 1 if the first step at the cached configuration exceeds the power limit, so it must be explored again
+int config_cache_stale(double power){
+
+	if(!cache_checking)
+		return 0;
+
+	cache_checking = 0;
+	if(power <= ctl->power_limit*(1+extra_range_percentage/100))
+		return 0;
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Cached configuration consumes %lf Watt, over the power limit\n", power);
+	#endif
+	return 1;
+}
+
+// Executed inside powercap_print_stats()
+void save_config_cache(){
+
+	char file_name[512];
+	FILE* cache_file;
+	int i, j, uncore = -1;
+	double weight, throughput, power;
+
+	if(!config_cache)
+		return;
+
+	config_cache_file_name(file_name);
+	if((cache_file = fopen(file_name, "w")) == NULL){
+		printf("Error opening configuration cache %s, it will not be updated\n", file_name);
+		return;
+	}
+
+	// Without a completed exploration the best configuration of the previous run is kept
+	if(ctl->stopped_searching && ctl->best_threads >= 1){
+		if(uncore_scaling && !uncore_searching)
+			uncore = current_uncore_pstate;
+		cache_best_threads = ctl->best_threads;
+		cache_best_pstate = ctl->best_pstate;
+		cache_best_throughput = ctl->best_throughput;
+		cache_best_power = ctl->best_power;
+		cache_best_uncore_pstate = uncore;
+	}
+
+	fprintf(cache_file, "BEST_THREADS=%d BEST_PSTATE=%d BEST_THROUGHPUT=%lf BEST_POWER=%lf BEST_UNCORE_PSTATE=%d\n",
+		cache_best_threads, cache_best_pstate, cache_best_throughput, cache_best_power, cache_best_uncore_pstate);
+
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			weight = pareto_sample(i, j, &throughput, &power);
+			if(weight > 0)
+				fprintf(cache_file, "%d %d %lf %lf %lf\n", i, j, weight, throughput, power);
+		}
+	}
+
+	fclose(cache_file);
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Configuration cache saved to %s\n", file_name);
+	#endif
+}
@@ -0,0 +1,120 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Phase change detection
+///////////////////////////////////////////////////////////////
+
+// Detection mode 5 restarts the exploration only when the workload changes, instead of every exploit_steps rounds.
+// The first CHANGE_WARMUP rounds at the best configuration after an exploration set the reference throughput and power.
+// Each following round at the best configuration feeds a two-sided Page-Hinkley test on the deviations relative to the references:
+// deviations within change_delta percent are tolerated, while the cumulative excess in the same direction triggers a change
+// when it exceeds change_threshold percent. Rounds at other configurations, as the HIGH and LOW ones of perform_fluctuation(), are ignored.
+// The references belong to the best configuration they were measured at. When the best configuration moves, as when perform_fluctuation()
+// shifts its p-states at the end of a window, the detector is reset and a new warmup measures the references of the new best configuration.
+
+#define CHANGE_WARMUP 5
+
+typedef struct page_hinkley{
+	double reference;		// Mean of the warmup rounds
+	double up;				// Cumulative sum of the increases exceeding delta, and its minimum
+	double up_min;
+	double down;			// Cumulative sum of the decreases exceeding delta, and its minimum
+	double down_min;
+} page_hinkley_t;
+
+// State of the detection of a controller
+typedef struct change_state{
+	page_hinkley_t throughput_detector;
+	page_hinkley_t power_detector;
+	int rounds;				// Rounds at the best configuration since the last reset
+	int reference_threads;	// Best configuration of the references, -1 before the first warmup round
+	int reference_pstate;
+} change_state_t;
+
+static void page_hinkley_reset(page_hinkley_t* detector){
+	detector->reference = 0;
+	detector->up = 0;
+	detector->up_min = 0;
+	detector->down = 0;
+	detector->down_min = 0;
+}
+
+// Adds a sample and returns 1 if the signal changed
+static int page_hinkley_update(page_hinkley_t* detector, double value){
+
+	double deviation = value/detector->reference - 1;
+	double delta = change_delta/100;
+
+	detector->up += deviation - delta;
+	if(detector->up < detector->up_min)
+		detector->up_min = detector->up;
+
+	detector->down += -deviation - delta;
+	if(detector->down < detector->down_min)
+		detector->down_min = detector->down;
+
+	return detector->up - detector->up_min > change_threshold/100 || detector->down - detector->down_min > change_threshold/100;
+}
+
+void change_detector_reset(){
+
+	change_state_t* change;
+
+	if(ctl->change == NULL)
+		ctl->change = malloc(sizeof(change_state_t));
+	change = ctl->change;
+
+	page_hinkley_reset(&change->throughput_detector);
+	page_hinkley_reset(&change->power_detector);
+	change->rounds = 0;
+	change->reference_threads = -1;
+	change->reference_pstate = -1;
+}
+
+// Returns 1 if the throughput or the power at the best configuration changed since the last exploration
+int detect_phase_change(double throughput, double power){
+
+	change_state_t* change;
+	int throughput_changed, power_changed;
+
+	if(ctl->change == NULL)
+		change_detector_reset();
+	change = ctl->change;
+
+	if(ctl->active_threads != ctl->best_threads || ctl->current_pstate != ctl->best_pstate)
+		return 0;
+
+	// The references of a previous best configuration do not apply to the current one
+	if(change->rounds > 0 && (change->reference_threads != ctl->best_threads || change->reference_pstate != ctl->best_pstate)){
+		#ifdef DEBUG_HEURISTICS
+			printf("BEST CONFIGURATION MOVED - threads %d - pstate %d. Phase change detector reset\n", ctl->best_threads, ctl->best_pstate);
+		#endif
+		change_detector_reset();
+	}
+
+	change->rounds++;
+	change->reference_threads = ctl->best_threads;
+	change->reference_pstate = ctl->best_pstate;
+	if(change->rounds <= CHANGE_WARMUP){
+		change->throughput_detector.reference += (throughput - change->throughput_detector.reference)/change->rounds;
+		change->power_detector.reference += (power - change->power_detector.reference)/change->rounds;
+		return 0;
+	}
+
+	throughput_changed = page_hinkley_update(&change->throughput_detector, throughput);
+	power_changed = page_hinkley_update(&change->power_detector, power);
+
+	if(throughput_changed || power_changed){
+		ctl->phase_changes++;
+
+		#ifdef DEBUG_HEURISTICS
+			printf("PHASE CHANGE DETECTED AFTER %d ROUNDS - throughput %lf (reference %lf) - power %lf (reference %lf)\n", change->rounds,
+				throughput, change->throughput_detector.reference, power, change->power_detector.reference);
+		#endif
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+#include "powercap.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Control socket
+///////////////////////////////////////////////////////////////
+
+// With control_socket set to a path instead of none, a thread listens on a Unix domain socket at that path so that an external
+// process, as a node power manager, can control the run. Each connection sends one command line and receives one reply line:
+// - POWER_LIMIT <watts>: changes power_limit, moving to the Pareto frontier point of the new limit as powercap_set_power_limit()
+// - HEURISTIC <mode>: switches to heuristic 9 to 18, which restarts the exploration from the initial configuration of that mode
+// - STATUS: returns power limit, heuristic, configuration, and throughput and power of the last round
+// The listener thread never changes the configuration itself: changes are posted in a mailbox that heuristic() consumes at the next
+// round, in the thread that owns the configuration. The round that consumes a change is discarded, as it ran with the previous settings.
+// A client has CONTROL_TIMEOUT milliseconds to send its command, so that a client that never sends it cannot block the listener
+// thread, nor shutdown_control_socket() that waits for it.
+
+#define CONTROL_COMMAND_SIZE 256
+#define CONTROL_TIMEOUT 1000
+
+static int control_fd = -1;
+static pthread_t control_thread;
+static volatile int control_stop;
+static int pending_heuristic_mode;		// Heuristic requested through the socket, 0 if none
+static double last_throughput;			// Throughput and power of the last round seen by heuristic()
+static double last_power;
+
+static void control_reply(int client, char* reply){
+
+	if(write(client, reply, strlen(reply)) < 0){
+		#ifdef DEBUG_HEURISTICS
+			printf("Error writing the reply of the control socket\n");
+		#endif
+	}
+}
+
+static void control_command(int client, char* command){
+
+	char reply[CONTROL_COMMAND_SIZE];
+	double limit;
+	int mode;
+
+	if(sscanf(command, "POWER_LIMIT %lf", &limit) == 1){
+		if(limit <= 0){
+			control_reply(client, "ERROR power limit must be higher than 0 Watt\n");
+			return;
+		}
+		if(node_budget > 0){
+			control_reply(client, "ERROR power limit is set by the node budget\n");
+			return;
+		}
+		__atomic_store(&pending_power_limit, &limit, __ATOMIC_RELEASE);
+		control_reply(client, "OK\n");
+	}else if(sscanf(command, "HEURISTIC %d", &mode) == 1){
+		if(mode < 9 || mode > 18){
+			control_reply(client, "ERROR heuristic must be in the range from 9 to 18\n");
+			return;
+		}
+		__atomic_store_n(&pending_heuristic_mode, mode, __ATOMIC_RELEASE);
+		control_reply(client, "OK\n");
+	}else if(strncmp(command, "STATUS", 6) == 0){
+		snprintf(reply, CONTROL_COMMAND_SIZE, "POWER_LIMIT=%lf HEURISTIC_MODE=%d THREADS=%d PSTATE=%d THROUGHPUT=%lf POWER=%lf SEARCHING=%d\n",
+			ctl->power_limit, ctl->heuristic_mode, active_threads, current_pstate, last_throughput, last_power, !ctl->stopped_searching);
+		control_reply(client, reply);
+	}else{
+		control_reply(client, "ERROR unknown command\n");
+	}
+}
+
+static void* control_loop(void* arg){
+
+	char command[CONTROL_COMMAND_SIZE];
+	struct timeval timeout;
+	int client;
+	ssize_t length;
+
+	timeout.tv_sec = CONTROL_TIMEOUT/1000;
+	timeout.tv_usec = (CONTROL_TIMEOUT%1000)*1000;
+
+	while(!control_stop){
+		client = accept(control_fd, NULL, NULL);
+		if(client < 0)
+			continue;
+
+		if(setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 || setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0){
+			close(client);
+			continue;
+		}
+
+		length = read(client, command, CONTROL_COMMAND_SIZE-1);
+		if(length > 0){
+			command[length] = '\0';
+			control_command(client, command);
+		}
+		close(client);
+	}
+
+	return NULL;
+}
+
+void init_control_socket(){
+
+	struct sockaddr_un address;
+
+	if(strcmp(control_socket, "none") == 0)
+		return;
+
+	if(strlen(control_socket) >= sizeof(address.sun_path)){
+		printf("Control socket path %s is too long\n", control_socket);
+		exit(1);
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, control_socket);
+	unlink(control_socket);
+
+	if((control_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || bind(control_fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(control_fd, 4) != 0){
+		printf("Error creating the control socket %s\n", control_socket);
+		exit(1);
+	}
+
+	control_stop = 0;
+	if(pthread_create(&control_thread, NULL, control_loop, NULL) != 0){
+		printf("Error creating the control socket thread\n");
+		exit(1);
+	}
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Listening for control commands on %s\n", control_socket);
+	#endif
+}
+
+void shutdown_control_socket(){
+
+	if(control_fd < 0)
+		return;
+
+	control_stop = 1;
+	shutdown(control_fd, SHUT_RDWR);
+	pthread_join(control_thread, NULL);
+	close(control_fd);
+	unlink(control_socket);
+	control_fd = -1;
+}
+
+static void switch_heuristic(int mode){
+
+	#ifdef DEBUG_HEURISTICS
+		printf("HEURISTIC SWITCHED FROM %d TO %d\n", ctl->heuristic_mode, mode);
+	#endif
+
+	ctl->heuristic_mode = mode;
+	if(ctl->heuristic_mode == 15){
+		init_model_matrices();
+		init_online_model();
+	}else if(ctl->heuristic_mode == 18){
+		init_online_model();
+		init_mpc();
+	}
+
+	// Heuristics that restart from the best configuration restart from the current one if the exploration was running
+	if(ctl->best_threads < 1){
+		ctl->best_threads = active_threads;
+		ctl->best_pstate = current_pstate;
+	}
+	restart_exploration();
+}
+
+// Called by heuristic() at each round. Returns 1 if a change from the mailbox was applied, so the sample of the round must be discarded
+int control_round(double throughput, double power){
+
+	int mode = __atomic_exchange_n(&pending_heuristic_mode, 0, __ATOMIC_ACQ_REL);
+
+	last_throughput = throughput;
+	last_power = power;
+
+	if(mode > 0){
+		switch_heuristic(mode);
+		apply_pending_power_limit();
+		return 1;
+	}
+
+	return apply_pending_power_limit();
+}
@@ -0,0 +1,139 @@
+#include "powercap.h"
+#include <semaphore.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Asynchronous controller
+///////////////////////////////////////////////////////////////
+
+// When async_controller is set, the heuristic does not run inside powercap_commit_work(). The committing thread only posts the
+// statistics of the completed round in a single-producer/single-consumer queue and returns to the application, while a dedicated
+// controller thread consumes the samples, calls heuristic() and applies the resulting p-state and thread changes.
+
+#define CONTROLLER_QUEUE_SIZE 64	// Must be a power of 2
+
+typedef struct round_sample{
+	double throughput;
+	double power;
+	long time;
+	long epoch;			// Value of config_epoch when the round started
+} round_sample_t;
+
+static round_sample_t controller_queue[CONTROLLER_QUEUE_SIZE];
+static volatile unsigned long queue_head;	// Next slot to consume, written only by the controller thread
+static volatile unsigned long queue_tail;	// Next slot to produce, written only by the committing thread
+static sem_t controller_sem;
+static pthread_t controller_thread;
+static volatile int controller_stop;
+static __thread int is_controller_thread;
+
+// Called by the committing thread. Returns 0 if the queue is full and the sample is dropped
+int controller_post_sample(double throughput, double power, long time, long epoch){
+
+	unsigned long tail = queue_tail;
+
+	if(tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) == CONTROLLER_QUEUE_SIZE){
+		controller_dropped_samples++;
+		return 0;
+	}
+
+	controller_queue[tail & (CONTROLLER_QUEUE_SIZE-1)].throughput = throughput;
+	controller_queue[tail & (CONTROLLER_QUEUE_SIZE-1)].power = power;
+	controller_queue[tail & (CONTROLLER_QUEUE_SIZE-1)].time = time;
+	controller_queue[tail & (CONTROLLER_QUEUE_SIZE-1)].epoch = epoch;
+	__atomic_store_n(&queue_tail, tail+1, __ATOMIC_RELEASE);
+
+	sem_post(&controller_sem);
+
+	return 1;
+}
+
+// Returns 1 if the calling thread is the controller thread. Used by set_threads() to defer changes that must be applied by the master thread
+int in_controller_thread(){
+	return is_controller_thread;
+}
+
+// Applies the number of threads requested by the controller. Must be called by the OpenMP master thread, as omp_set_num_threads() only affects the calling thread
+void apply_pending_threads(){
+
+	int to_threads = __atomic_exchange_n(&pending_threads, 0, __ATOMIC_ACQ_REL);
+
+	if(to_threads > 0)
+		omp_set_num_threads(to_threads);
+}
+
+static void* controller_loop(void* arg){
+
+	round_sample_t sample;
+	unsigned long head;
+	int previous_threads, previous_pstate;
+
+	is_controller_thread = 1;
+
+	while(1){
+		sem_wait(&controller_sem);
+
+		head = queue_head;
+		if(head == __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE)){
+			if(controller_stop)
+				break;
+			continue;
+		}
+
+		sample = controller_queue[head & (CONTROLLER_QUEUE_SIZE-1)];
+		__atomic_store_n(&queue_head, head+1, __ATOMIC_RELEASE);
+
+		// Rounds that started before the last configuration change was applied are measured on a mix of configurations
+		if(sample.epoch != config_epoch){
+			controller_stale_samples++;
+			continue;
+		}
+
+		previous_threads = active_threads;
+		previous_pstate = current_pstate;
+
+		heuristic(sample.throughput, sample.power, sample.time);
+
+		if(previous_threads != active_threads || previous_pstate != current_pstate)
+			__atomic_add_fetch(&config_epoch, 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+void init_controller(){
+
+	queue_head = 0;
+	queue_tail = 0;
+	controller_stop = 0;
+	controller_dropped_samples = 0;
+	controller_stale_samples = 0;
+	pending_threads = 0;
+	config_epoch = 0;
+
+	if(!async_controller)
+		return;
+
+	sem_init(&controller_sem, 0, 0);
+
+	if(pthread_create(&controller_thread, NULL, controller_loop, NULL) != 0){
+		printf("Error creating the controller thread\n");
+		exit(1);
+	}
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Asynchronous controller thread started\n");
+	#endif
+}
+
+// Waits for the controller to consume the pending samples and terminates it
+void shutdown_controller(){
+
+	if(!async_controller || controller_stop)
+		return;
+
+	controller_stop = 1;
+	sem_post(&controller_sem);
+	pthread_join(controller_thread, NULL);
+}
@@ -0,0 +1,181 @@
+#include "powercap.h"
+#include <stdlib.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Controllers
+///////////////////////////////////////////////////////////////
+
+// The heuristics read and change the controller of the calling thread through ctl. The runtime only drives main_controller,
+// whose actuators change the configuration of the application. A trace replay creates a controller for each heuristic to
+// evaluate, with actuators that only record the configuration, and steps each of them on its own thread with controller_step().
+// The settings of the runtime, as round length, exploit_steps and the uncore and phase support, are shared by all the controllers.
+
+__thread controller_t* ctl = &main_controller;
+
+// Sets the p-state through the actuator of the selected controller
+int set_pstate(int input_pstate){
+
+	int result = 0;
+
+	if(ctl == &main_controller)
+		duty_cycle_lock();
+
+	if(ctl->apply_pstate(input_pstate) != 0)
+		result = -1;
+	else
+		ctl->current_pstate = input_pstate;
+
+	if(ctl == &main_controller)
+		duty_cycle_unlock();
+
+	return result;
+}
+
+// Sets the number of threads through the actuator of the selected controller
+void set_threads(int threads){
+
+	if(ctl == &main_controller)
+		duty_cycle_lock();
+
+	ctl->apply_threads(threads);
+	ctl->active_threads = threads;
+
+	if(ctl == &main_controller)
+		duty_cycle_unlock();
+}
+
+// Initial state of the search. Settings and actuators must be set, and max_pstate and total_threads initialized
+void controller_init(controller_t* controller){
+
+	controller->steps = 0;
+	controller->stopped_searching = 0;
+	controller->current_exploit_steps = 0;
+	controller->phase = 0;
+	controller->decreasing = 0;
+
+	controller->best_throughput = -1;
+	controller->best_pstate = -1;
+	controller->best_threads = -1;
+	controller->level_best_throughput = -1;
+	controller->level_best_threads = 0;
+
+	controller->min_pstate_search = 0;
+	controller->max_pstate_search = max_pstate;
+	controller->min_thread_search = 1;
+	controller->max_thread_search = total_threads;
+	controller->min_thread_search_throughput = -1;
+	controller->max_thread_search_throughput = -1;
+
+	controller->high_throughput = -1;
+	controller->high_threads = -1;
+	controller->high_pstate = -1;
+	controller->low_throughput = -1;
+	controller->low_threads = -1;
+	controller->low_pstate = -1;
+
+	controller->validation_pstate = max_pstate-1;
+
+	controller->bandit_moves = 0;
+	controller->bandit_neighbor_rounds = 0;
+	controller->phase_changes = 0;
+}
+
+// Sets the initial configuration of the heuristic of the selected controller and allocates its state
+void controller_start(){
+
+  	// Necessary for the static execution in order to avoid running for the first step with a different frequency than manually set in hope_config.txt
+	if(ctl->heuristic_mode == 8){
+		if(static_pstate >= 0 && static_pstate <= max_pstate)
+			set_pstate(static_pstate);
+		else
+			printf("The parameter manual_pstate is set outside of the valid range for this CPU. Setting the CPU to the slowest frequency/voltage\n");
+	}else if(ctl->heuristic_mode == 12 || ctl->heuristic_mode == 13 || ctl->heuristic_mode == 15 || ctl->heuristic_mode == 17 || ctl->heuristic_mode == 18){
+		set_pstate(max_pstate);
+		ctl->starting_threads = 1;
+	}
+
+	if(ctl->heuristic_mode == 15){
+		init_model_matrices();
+		init_online_model();
+	}else if(ctl->heuristic_mode == 18){
+		init_online_model();
+		init_mpc();
+	}
+
+	init_pareto();
+}
+
+void controller_select(controller_t* controller){
+	ctl = controller;
+}
+
+// Creates a controller running the given heuristic with the other settings of main_controller. The actuators are called with
+// the initial configuration, as main_controller at the end of the ramp up. The selected controller is not changed
+controller_t* controller_create(int heuristic_mode, int (*apply_pstate)(int), void (*apply_threads)(int)){
+
+	controller_t* previous = ctl;
+	controller_t* controller = calloc(1, sizeof(controller_t));
+
+	if(controller == NULL){
+		printf("Error allocating a controller\n");
+		exit(1);
+	}
+
+	controller->heuristic_mode = heuristic_mode;
+	controller->detection_mode = main_controller.detection_mode;
+	controller->power_limit = main_controller.power_limit;
+	controller->starting_threads = main_controller.starting_threads;
+	controller->objective = main_controller.objective;
+	controller->energy_budget = main_controller.energy_budget;
+	controller->apply_pstate = apply_pstate;
+	controller->apply_threads = apply_threads;
+	controller_init(controller);
+
+	controller_select(controller);
+	set_pstate(max_pstate);
+	controller_start();
+	set_threads(ctl->starting_threads);
+	controller_select(previous);
+
+	return controller;
+}
+
+static void free_matrix(double** matrix){
+
+	int i;
+
+	if(matrix == NULL)
+		return;
+
+	for(i = 0; i <= max_pstate; i++)
+		free(matrix[i]);
+	free(matrix);
+}
+
+void controller_free(controller_t* controller){
+
+	if(controller == &main_controller){
+		printf("main_controller cannot be freed\n");
+		exit(1);
+	}
+
+	if(ctl == controller)
+		controller_select(&main_controller);
+
+	free_matrix(controller->power_model);
+	free_matrix(controller->throughput_model);
+	free_matrix(controller->power_validation);
+	free_matrix(controller->throughput_validation);
+	free_matrix(controller->power_real);
+	free_matrix(controller->throughput_real);
+
+	free_online_model(controller);
+	free_mpc(controller);
+	free_pareto(controller);
+	free(controller->bo);
+	free(controller->bandit);
+	free(controller->change);
+	free(controller);
+}
@@ -0,0 +1,88 @@
+#ifndef CONTROLLER_T_POWERCAP
+#define CONTROLLER_T_POWERCAP
+
+// State of a controller, which chooses the configuration to run from the throughput and power of each round. The runtime drives
+// main_controller, while a trace replay can create further controllers with controller_create(), each with its own settings,
+// actuators and state of the heuristics, and run them concurrently on different threads. The code of the heuristics accesses the
+// controller of the calling thread through ctl, set with controller_select(). Threads that never select one use main_controller.
+// The state of heuristic 15 and 18 models, heuristic 17, Thompson sampling, phase change detection and the sampled configurations
+// is private to their modules, and allocated on demand by each of them.
+typedef struct controller{
+
+    // Settings, set from powercap_config.txt for main_controller
+    int heuristic_mode;
+    int detection_mode;
+    double power_limit;                 // Expressed in Watt
+    int starting_threads;               // Number of threads running at the start of the exploration
+    int objective;                      // Objective optimized within power_limit, see objective.c
+    double energy_budget;               // Energy per commit allowed by objective 4, expressed in Joule
+
+    // Configuration chosen by the controller, changed with set_pstate() and set_threads() through the actuators
+    int current_pstate;
+    int active_threads;
+    int (*apply_pstate)(int input_pstate);  // Returns 0 if the p-state was applied
+    void (*apply_threads)(int threads);
+
+    // Search of the best configuration
+    int steps;                          // Number of steps of the current exploration
+    int stopped_searching;              // 0 while exploring, 1 once the best configuration is set
+    int current_exploit_steps;          // Steps since the last completed exploration
+    int phase;                          // Phase of the exploration, with different semantics for each heuristic
+    int decreasing;                     // 1 while the number of threads is decreasing
+    double best_throughput;             // Score of the objective of the best configuration found so far, -1 if none
+    int best_threads;
+    int best_pstate;
+    double best_power;
+    double level_best_throughput;       // Best configuration found at the current p-state
+    int level_best_threads;
+    int level_best_pstate;
+    int phase0_pstate;
+    int phase0_threads;
+    int min_pstate_search;              // Ranges of the binary search of heuristic 12
+    int max_pstate_search;
+    int min_thread_search;
+    int max_thread_search;
+    double min_thread_search_throughput;
+    double max_thread_search_throughput;
+
+    // HIGH and LOW configurations alternated with the best one by perform_fluctuation()
+    double high_throughput;
+    int high_pstate;
+    int high_threads;
+    double high_power;
+    double low_throughput;
+    int low_pstate;
+    int low_threads;
+    double low_power;
+    int current_window_slot;            // Current slot within the window
+    double window_time;                 // Sum of the time of the current window, expressed in nano seconds
+    double window_power;                // Average power of the current window, expressed in Watt
+    int fluctuation_state;              // Configuration of the last step, -1 for LOW, 0 for BEST, 1 for HIGH
+
+    // Heuristic 15. Rows are p-states, columns are threads, the first column is unused
+    double** power_model;
+    double** throughput_model;
+    double** power_validation;
+    double** throughput_validation;
+    double** power_real;
+    double** throughput_real;
+    int validation_pstate;              // P-state validated by detection mode 3
+    int model_setup_rounds;             // Rounds spent in the current setup of the models
+    long model_setup_rounds_sum;        // Rounds spent in all the completed setups
+    int model_setups;                   // Number of completed setups
+
+    // Statistics reported in the stats file
+    long bandit_moves;                  // Number of times the neighborhood of Thompson sampling moved to a better neighbor
+    long bandit_neighbor_rounds;        // Number of rounds spent on a neighbor of the best configuration
+    long phase_changes;                 // Number of phase changes detected with detection mode 5
+
+    // State of the heuristics, private to their modules. NULL until first used
+    struct model_state* model;
+    struct bo_state* bo;
+    struct bandit_state* bandit;
+    struct mpc_state* mpc;
+    struct change_state* change;
+    struct pareto_state* pareto;
+} controller_t;
+
+#endif
@@ -0,0 +1,244 @@
+#include "powercap.h"
+#include <time.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Duty cycling between two p-states
+///////////////////////////////////////////////////////////////
+
+// With duty_cycling, the exploitation of heuristics 10, 13, 15 and 16 replaces the BEST/HIGH/LOW fluctuation of perform_fluctuation().
+// It runs a convex combination of two adjacent p-states at the best number of threads: the LOW one within power_limit and the HIGH one above it.
+// A dedicated thread alternates them every duty_period milliseconds, spending the share of each period at HIGH that makes the mean power
+// equal to power_limit. The share starts from the interpolation of the power of the two p-states, each measured for one round, and is then
+// corrected at each round by the distance of the round power from power_limit. If the share stays saturated at 0 or 1 for DUTY_SHIFT_ROUNDS
+// rounds, the pair is moved by one p-state and measured again. Only the p-state alternates, since the number of threads changes only at the
+// next parallel region. Requires the heuristic to run inline, as the asynchronous controller also changes the p-state.
+// The actuators of main_controller run under duty_lock, both in the duty thread and, through duty_cycle_lock(), in the thread of the
+// heuristic, so that a p-state switch never interleaves with the per-core p-states written by a change of threads with core packing.
+
+#define DUTY_GAIN 0.5				// Fraction of the power error corrected at each round
+#define DUTY_SHIFT_ROUNDS 3			// Rounds with saturated share before moving the pair of p-states
+
+#define DUTY_IDLE 0					// No round measured since the exploration, the round ran at the best configuration
+#define DUTY_MEASURE_LOW 1			// The round ran at the LOW p-state
+#define DUTY_MEASURE_HIGH 2			// The round ran at the HIGH p-state
+#define DUTY_CYCLING 3				// The round ran alternating the two p-states
+
+static pthread_t duty_thread;
+static pthread_mutex_t duty_lock = PTHREAD_MUTEX_INITIALIZER;	// Held while an actuator of main_controller runs
+static volatile int duty_running;		// Cleared to terminate the duty thread
+static volatile int duty_active;		// 1 while the duty thread alternates the p-states
+static volatile double duty_share;		// Share of each period at the HIGH p-state
+static int duty_high_pstate;
+static int duty_low_pstate;
+static double duty_high_power;
+static double duty_low_power;
+static int duty_state = DUTY_IDLE;
+static int duty_saturated_rounds;
+static double duty_share_time;			// Sum of the share weighted by the time of each round, and the time of the rounds
+static double duty_time;
+
+static void duty_sleep(long nanoseconds){
+
+	struct timespec interval;
+
+	interval.tv_sec = nanoseconds / 1000000000;
+	interval.tv_nsec = nanoseconds % 1000000000;
+	nanosleep(&interval, NULL);
+}
+
+// Switches the p-state of main_controller from the duty thread, which already holds duty_lock
+static void duty_switch_pstate(int input_pstate){
+
+	if(main_controller.apply_pstate(input_pstate) == 0)
+		main_controller.current_pstate = input_pstate;
+}
+
+static void* duty_loop(void* arg){
+
+	long period = (long) (duty_period*1000000), high_time;
+
+	while(duty_running){
+		pthread_mutex_lock(&duty_lock);
+		high_time = duty_active ? (long) (duty_share*period) : 0;
+		if(duty_active && high_time > 0)
+			duty_switch_pstate(duty_high_pstate);
+		pthread_mutex_unlock(&duty_lock);
+
+		if(high_time > 0)
+			duty_sleep(high_time);
+
+		pthread_mutex_lock(&duty_lock);
+		if(duty_active && high_time < period)
+			duty_switch_pstate(duty_low_pstate);
+		pthread_mutex_unlock(&duty_lock);
+
+		if(high_time < period)
+			duty_sleep(period - high_time);
+	}
+
+	return NULL;
+}
+
+static void duty_cycle_suspend(){
+
+	pthread_mutex_lock(&duty_lock);
+	duty_active = 0;
+	pthread_mutex_unlock(&duty_lock);
+}
+
+static void duty_cycle_measure(int state, int input_pstate){
+
+	duty_cycle_suspend();
+	duty_state = state;
+	set_pstate(input_pstate);
+}
+
+void init_duty_cycle(){
+
+	duty_share_time = 0;
+	duty_time = 0;
+
+	if(!duty_cycling)
+		return;
+
+	duty_running = 1;
+	if(pthread_create(&duty_thread, NULL, duty_loop, NULL) != 0){
+		printf("Error creating the duty cycling thread\n");
+		exit(1);
+	}
+}
+
+void shutdown_duty_cycle(){
+
+	if(!duty_cycling || !duty_running)
+		return;
+
+	duty_cycle_suspend();
+	duty_running = 0;
+	pthread_join(duty_thread, NULL);
+}
+
+// Called by set_pstate() and set_threads() around the actuators of main_controller, serializes them with the duty thread
+void duty_cycle_lock(){
+	if(duty_cycling)
+		pthread_mutex_lock(&duty_lock);
+}
+
+void duty_cycle_unlock(){
+	if(duty_cycling)
+		pthread_mutex_unlock(&duty_lock);
+}
+
+// Called when the exploration restarts, the next exploitation measures a new pair from the best configuration
+void duty_cycle_reset(){
+
+	if(duty_cycling)
+		duty_cycle_suspend();
+	duty_state = DUTY_IDLE;
+}
+
+// Returns 1 while the rounds are measured alternating the two p-states
+int duty_cycle_active(){
+	return duty_active;
+}
+
+// Mean share of time at the HIGH p-state over the rounds alternating the two p-states
+double duty_cycle_mean_share(){
+	return duty_time > 0 ? duty_share_time/duty_time : 0;
+}
+
+void duty_cycle_update(double throughput, double power, long time){
+
+	double share;
+
+	switch(duty_state){
+		case DUTY_IDLE:
+		case DUTY_MEASURE_LOW:
+			if(duty_state == DUTY_IDLE){
+				duty_low_pstate = ctl->best_pstate;
+				duty_high_pstate = ctl->best_pstate > 0 ? ctl->best_pstate-1 : ctl->best_pstate;
+			}
+			duty_low_power = power;
+
+			// The LOW p-state must be within power_limit
+			if(power > ctl->power_limit && duty_low_pstate < max_pstate){
+				duty_high_pstate = duty_low_pstate;
+				duty_low_pstate++;
+				duty_cycle_measure(DUTY_MEASURE_LOW, duty_low_pstate);
+				return;
+			}
+
+			if(duty_high_pstate == duty_low_pstate){
+				duty_high_power = power;
+				duty_share = 0;
+				duty_state = DUTY_CYCLING;
+				return;
+			}
+
+			duty_cycle_measure(DUTY_MEASURE_HIGH, duty_high_pstate);
+			return;
+
+		case DUTY_MEASURE_HIGH:
+			duty_high_power = power;
+
+			// The HIGH p-state must be above power_limit, unless it is the highest frequency
+			if(power < ctl->power_limit && duty_high_pstate > 0){
+				duty_low_pstate = duty_high_pstate;
+				duty_low_power = power;
+				duty_high_pstate--;
+				duty_cycle_measure(DUTY_MEASURE_HIGH, duty_high_pstate);
+				return;
+			}
+
+			share = duty_high_power > duty_low_power ? (ctl->power_limit - duty_low_power)/(duty_high_power - duty_low_power) : 1;
+			duty_share = share < 0 ? 0 : (share > 1 ? 1 : share);
+			duty_saturated_rounds = 0;
+			duty_state = DUTY_CYCLING;
+
+			pthread_mutex_lock(&duty_lock);
+			duty_active = 1;
+			pthread_mutex_unlock(&duty_lock);
+
+			#ifdef DEBUG_HEURISTICS
+				printf("DUTY CYCLING - LOW p-state %d (%lf Watt) - HIGH p-state %d (%lf Watt) - share %lf\n", duty_low_pstate, duty_low_power,
+					duty_high_pstate, duty_high_power, duty_share);
+			#endif
+			return;
+
+		case DUTY_CYCLING:
+			duty_share_time += duty_share*time;
+			duty_time += time;
+
+			if(duty_high_pstate == duty_low_pstate)
+				return;
+
+			share = duty_share + DUTY_GAIN*(ctl->power_limit - power)/(duty_high_power > duty_low_power ? duty_high_power - duty_low_power : ctl->power_limit);
+
+			if(share > 1 || share < 0)
+				duty_saturated_rounds++;
+			else
+				duty_saturated_rounds = 0;
+			duty_share = share < 0 ? 0 : (share > 1 ? 1 : share);
+
+			#ifdef DEBUG_HEURISTICS
+				printf("Duty cycling - power %lf - throughput %lf - share %lf\n", power, throughput, duty_share);
+			#endif
+
+			if(duty_saturated_rounds >= DUTY_SHIFT_ROUNDS){
+				if(share > 1 && duty_high_pstate > 0){
+					duty_low_pstate = duty_high_pstate;
+					duty_high_pstate--;
+				}else if(share < 0 && duty_low_pstate < max_pstate){
+					duty_high_pstate = duty_low_pstate;
+					duty_low_pstate++;
+				}else{
+					duty_saturated_rounds = 0;
+					return;
+				}
+				duty_cycle_measure(DUTY_MEASURE_LOW, duty_low_pstate);
+			}
+			return;
+	}
+}
@@ -0,0 +1,337 @@
+#include "powercap.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// DVFS actuator
+///////////////////////////////////////////////////////////////
+
+// The scaling_setspeed files of all cores are opened once by init_DVFS_management() and kept open for the whole execution.
+// A p-state change is then a single pwrite per core, without the open/write/flush/close sequence in the critical path of powercap_commit_work()
+static int* setspeed_fd;
+static int setspeed_is_regular;	// Set to 1 if the files are regular files (fake sysfs tree), that must be truncated after each write
+
+// Resets the statistics of the actuator and the p-state of each core. Must be called once the array of p-states is created
+static void init_core_pstates(){
+
+	int i;
+
+	core_pstate = malloc(sizeof(int)*nb_cores);
+	for(i=0; i<nb_cores; i++)
+		core_pstate[i] = -1;
+
+	if(idle_pstate < 0 || idle_pstate > max_pstate)
+		idle_pstate = max_pstate;
+
+	dvfs_transitions = 0;
+	dvfs_latency_sum = 0;
+	dvfs_last_latency = 0;
+	dvfs_max_latency = 0;
+}
+
+// Opens the scaling_setspeed file of each core and keeps the descriptors in setspeed_fd
+static void open_setspeed_files(){
+
+	char fname[512];
+	struct stat st;
+	int i;
+
+	setspeed_fd = malloc(sizeof(int)*nb_cores);
+
+	for(i=0; i<nb_cores; i++){
+		sprintf(fname, "%s/devices/system/cpu/cpu%d/cpufreq/scaling_setspeed", sysfs_root, i);
+		setspeed_fd[i] = open(fname, O_WRONLY);
+		if(setspeed_fd[i] < 0){
+			printf("Error opening cpu%d scaling_setspeed file. Must be superuser\n", i);
+			exit(0);
+		}
+	}
+
+	setspeed_is_regular = (fstat(setspeed_fd[0], &st) == 0 && S_ISREG(st.st_mode));
+
+	init_core_pstates();
+}
+
+// Writes the governor of all cores. Called only at startup, therefore it does not rely on persistent descriptors
+static void set_governor_userspace(){
+
+	char fname[512];
+	FILE* governor_file;
+	int i;
+
+	for(i=0; i<nb_cores;i++){
+		sprintf(fname, "%s/devices/system/cpu/cpu%d/cpufreq/scaling_governor", sysfs_root, i);
+		governor_file = fopen(fname,"w+");
+		if(governor_file == NULL){
+			printf("Error opening cpu%d scaling_governor file. Must be superuser\n", i);
+			exit(0);
+		}
+		fprintf(governor_file, "userspace");
+		fflush(governor_file);
+		fclose(governor_file);
+	}
+}
+
+// Requests the frequency, expressed in KHz, to all cores through scaling_setspeed
+void sysfs_set_frequency(int frequency){
+
+	char frequency_string[16];
+	int i, len;
+
+	len = sprintf(frequency_string, "%d", frequency);
+
+	for(i=0; i<nb_cores; i++){
+		if(pwrite(setspeed_fd[i], frequency_string, len, 0) != len){
+			printf("Error writing cpu%d scaling_setspeed file\n", i);
+			exit(0);
+		}
+		if(setspeed_is_regular && ftruncate(setspeed_fd[i], len) != 0){
+			printf("Error truncating cpu%d scaling_setspeed file\n", i);
+			exit(0);
+		}
+	}
+}
+
+// Requests the frequency, expressed in KHz, to a single core through scaling_setspeed
+void sysfs_set_core_frequency(int core, int frequency){
+
+	char frequency_string[16];
+	int len;
+
+	len = sprintf(frequency_string, "%d", frequency);
+
+	if(pwrite(setspeed_fd[core], frequency_string, len, 0) != len){
+		printf("Error writing cpu%d scaling_setspeed file\n", core);
+		exit(0);
+	}
+	if(setspeed_is_regular && ftruncate(setspeed_fd[core], len) != 0){
+		printf("Error truncating cpu%d scaling_setspeed file\n", core);
+		exit(0);
+	}
+}
+
+// Returns 1 if the core runs application threads. With core packing the threads run on cores from 0 to packed_cores-1.
+// With per-package DVFS a core is active if any core of its package is active
+static int core_is_active(int core){
+
+	int i;
+
+	if(core < packed_cores)
+		return 1;
+
+	if(dvfs_domain == 2){
+		for(i = 0; i < packed_cores; i++){
+			if(core_package[i] == core_package[core])
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Sets the p-state of a single core, only writing the frequency if it changed. Used when dvfs_domain is per core or per package
+void set_core_pstate(int core, int input_pstate){
+
+	if(input_pstate < 0 || input_pstate > max_pstate || core < 0 || core >= nb_cores)
+		return;
+
+	if(core_pstate[core] != input_pstate){
+		backend->set_core_frequency(core, pstate[input_pstate]);
+		core_pstate[core] = input_pstate;
+	}
+}
+
+// Sets active cores to current_pstate and parked cores to idle_pstate. Called whenever either the p-state or the packed cores change
+void update_core_pstates(){
+
+	int i;
+
+	for(i = 0; i < nb_cores; i++){
+		if(core_is_active(i))
+			set_core_pstate(i, current_pstate);
+		else
+			set_core_pstate(i, idle_pstate);
+	}
+}
+
+// Changes the p-state used for parked cores
+void set_idle_pstate(int input_pstate){
+
+	if(input_pstate < 0 || input_pstate > max_pstate)
+		return;
+
+	idle_pstate = input_pstate;
+	if(dvfs_domain != 0)
+		update_core_pstates();
+}
+
+// Actuator of main_controller, sets the p-state of the cores running application threads. With global DVFS all the cores are set to the same p-state
+int apply_pstate(int input_pstate){
+
+	long start_time, latency;
+	int i;
+
+	if(input_pstate > max_pstate)
+		return -1;
+
+	if(current_pstate != input_pstate){
+
+		start_time = get_time();
+
+		if(dvfs_domain == 0){
+			backend->set_frequency(pstate[input_pstate]);
+			for(i = 0; i < nb_cores; i++)
+				core_pstate[i] = input_pstate;
+			current_pstate = input_pstate;
+		}else{
+			current_pstate = input_pstate;
+			update_core_pstates();
+		}
+
+		// Latency of the transition, as seen by the thread that requested it
+		latency = get_time() - start_time;
+		dvfs_last_latency = latency;
+		dvfs_latency_sum += latency;
+		if(latency > dvfs_max_latency)
+			dvfs_max_latency = latency;
+		dvfs_transitions++;
+	}
+	return 0;
+}
+
+// Used to either enable or disable boosting facilities such as TurboBoost. Boost is disabled whenever the current config goes out of the powercap
+void set_boost(int value){
+
+	char fname[512];
+	FILE* boost_file;
+
+	if(value != 0 && value != 1){
+		printf("Set_boost parameter invalid. Shutting down application\n");
+		exit(1);
+	}
+
+	sprintf(fname, "%s/devices/system/cpu/cpufreq/boost", sysfs_root);
+	boost_file = fopen(fname, "w+");
+	if(boost_file == NULL){
+		printf("Error opening boost_file\n");
+		exit(0);
+	}
+	fprintf(boost_file, "%d", value);
+	fflush(boost_file);
+	fclose(boost_file);
+
+	return;
+}
+
+// Sets the governor to userspace and sets the highest frequency
+int init_DVFS_management(){
+
+	char fname[512];
+	char* freq_available;
+	int frequency, i;
+
+	//Set governor to userspace
+	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	set_governor_userspace();
+
+	// Init array of available frequencies
+	sprintf(fname, "%s/devices/system/cpu/cpu0/cpufreq/scaling_available_frequencies", sysfs_root);
+	FILE* available_freq_file = fopen(fname,"r");
+	if(available_freq_file == NULL){
+		printf("Cannot open scaling_available_frequencies file\n");
+		exit(0);
+	}
+	freq_available = malloc(sizeof(char)*256);
+	if(fgets(freq_available, 256, available_freq_file) == NULL){
+		printf("Cannot read scaling_available_frequencies file\n");
+		exit(0);
+	}
+
+	pstate = malloc(sizeof(int)*32);
+	i = 0;
+	char * end;
+
+	for (frequency = strtol(freq_available, &end, 10); freq_available != end; frequency = strtol(freq_available, &end, 10)){
+		pstate[i]=frequency;
+		freq_available = end;
+		i++;
+	}
+	max_pstate = --i;
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Found %d p-states in the range from %d MHz to %d MHz\n", max_pstate, pstate[max_pstate]/1000, pstate[0]/1000);
+  	#endif
+	fclose(available_freq_file);
+
+	open_setspeed_files();
+
+	current_pstate = -1;
+	set_pstate(max_pstate);
+
+	set_boost(boost_disabled);
+
+	return 0;
+}
+
+// Creates the array of p-states from min_cpu_freq to max_cpu_freq with steps of 100MHz. P-state 0 is the boost frequency
+static void init_pstate_range(){
+
+	int frequency, i;
+
+	// One p-state every 100MHz from min_cpu_freq to max_cpu_freq, plus p-state 0
+	pstate = malloc(sizeof(int)*32);
+	i = (max_cpu_freq-min_cpu_freq)/100000+2;
+	printf("\nCreating Cpu frequency list with %i p-states\n",i);
+	max_pstate = --i;
+	frequency=min_cpu_freq;
+	while(frequency<=max_cpu_freq) {
+		pstate[i]=frequency;
+		printf(" pstate[%i]:%i",i,pstate[i]);
+		frequency+=100000;
+		i--;
+	}
+	//set pstate 0
+	if (boost_disabled) frequency-=100000;
+	pstate[i]=frequency;
+	printf(" pstate[%i]:%i",i,pstate[i]);
+	if (boost_disabled) printf("(disabled)");
+
+	printf("\nCpu frequency list completed\n");
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Created %d p-states in the range from %d MHz to %d MHz\n", max_pstate+1, pstate[max_pstate]/1000, pstate[0]/1000);
+  	#endif
+}
+
+// Sets the governor to userspace and sets the highest frequency
+int init_DVFS_management_intel_pstate_passive_mode(){
+
+	//Set governor to userspace
+	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	printf("Number of available cores: %i\n ", nb_cores);
+	set_governor_userspace();
+
+	// Init array of available frequencies
+	init_pstate_range();
+
+	open_setspeed_files();
+
+	current_pstate = -1;
+	set_pstate(max_pstate);
+
+	return 0;
+}
+
+// DVFS management for backends that do not rely on cpufreq. Only creates the array of p-states, the highest frequency is set by the backend
+// once its actuators are ready. With the MSR backend the cpufreq governor should not be changing the frequency in the meanwhile
+int init_DVFS_management_pstate_range(){
+
+	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	init_pstate_range();
+	init_core_pstates();
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include "powercap.h"
+#include <fcntl.h>
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// RAPL energy source
+///////////////////////////////////////////////////////////////
+
+// The energy_uj files of all RAPL domains are opened once by init_energy_management() and read with pread.
+// Each domain keeps the last raw value of its counter, so that a wraparound of energy_uj is corrected using max_energy_range_uj
+// and the energy returned to the caller is always monotonically increasing.
+
+typedef struct rapl_domain{
+	int fd;					// Descriptor of energy_uj, -1 if the domain is not available
+	long max_energy_range;	// Value of max_energy_range_uj, expressed in micro Joule
+	long last_raw;			// Last value read from energy_uj
+	long energy;			// Energy consumed since init_energy_management(), corrected for wraparounds
+} rapl_domain_t;
+
+static rapl_domain_t* package_domains;
+static rapl_domain_t* core_domains;		// Subdomain intel-rapl:N:X named "core"
+static rapl_domain_t* dram_domains;		// Subdomain intel-rapl:N:X named "dram"
+static pthread_mutex_t rapl_lock = PTHREAD_MUTEX_INITIALIZER;	// get_energy() might run on the application, controller and duty cycling threads
+
+// Reads a long value from an already opened sysfs file
+static long read_sysfs_long(int fd){
+
+	char buffer[32];
+	ssize_t len = pread(fd, buffer, sizeof(buffer)-1, 0);
+
+	if(len <= 0)
+		return -1;
+	buffer[len] = '\0';
+
+	return strtol(buffer, NULL, 10);
+}
+
+// Opens energy_uj and reads max_energy_range_uj from the domain directory. Returns 0 if the domain is not available
+static int open_rapl_domain(rapl_domain_t* domain, char* domain_path){
+
+	char fname[512];
+	int fd;
+
+	domain->fd = -1;
+	domain->energy = 0;
+
+	sprintf(fname, "%s/max_energy_range_uj", domain_path);
+	fd = open(fname, O_RDONLY);
+	if(fd < 0)
+		return 0;
+	domain->max_energy_range = read_sysfs_long(fd);
+	close(fd);
+
+	sprintf(fname, "%s/energy_uj", domain_path);
+	domain->fd = open(fname, O_RDONLY);
+	if(domain->fd < 0)
+		return 0;
+	domain->last_raw = read_sysfs_long(domain->fd);
+
+	return 1;
+}
+
+// Updates the energy of the domain with the current value of the counter
+static long read_rapl_domain(rapl_domain_t* domain){
+
+	long raw, delta, energy;
+
+	if(domain->fd < 0)
+		return 0;
+
+	pthread_mutex_lock(&rapl_lock);
+
+	raw = read_sysfs_long(domain->fd);
+	if(raw >= 0){
+		delta = raw - domain->last_raw;
+
+		if(delta < 0){	// The counter wrapped around from max_energy_range to 0
+			delta += domain->max_energy_range + 1;
+			energy_wraparounds++;
+		}
+
+		domain->last_raw = raw;
+		domain->energy += delta;
+	}
+	energy = domain->energy;
+
+	pthread_mutex_unlock(&rapl_lock);
+
+	return energy;
+}
+
+// Opens the package domains and their core and DRAM subdomains for all the packages in the system
+void init_energy_management(){
+
+	char domain_path[384], subdomain_path[448], fname[512], name[32];
+	FILE* name_file;
+	int i, j;
+
+	package_domains = malloc(sizeof(rapl_domain_t)*nb_packages);
+	core_domains = malloc(sizeof(rapl_domain_t)*nb_packages);
+	dram_domains = malloc(sizeof(rapl_domain_t)*nb_packages);
+	energy_wraparounds = 0;
+
+	for(i = 0; i<nb_packages; i++){
+
+		sprintf(domain_path, "%s/class/powercap/intel-rapl/intel-rapl:%d", sysfs_root, i);
+		if(!open_rapl_domain(&package_domains[i], domain_path)){
+			printf("Error opening energy file of package %d\n", i);
+			exit(1);
+		}
+
+		core_domains[i].fd = -1;
+		dram_domains[i].fd = -1;
+
+		// Subdomain numbering is not fixed, as intel-rapl:N:1 is the DRAM on servers and the uncore on client processors
+		for(j = 0; j < 2; j++){
+			sprintf(subdomain_path, "%s/intel-rapl:%d:%d", domain_path, i, j);
+			sprintf(fname, "%s/name", subdomain_path);
+			name_file = fopen(fname, "r");
+			if(name_file == NULL)
+				continue;
+			if(fscanf(name_file, "%31s", name) == 1){
+				if(strcmp(name, "core") == 0)
+					open_rapl_domain(&core_domains[i], subdomain_path);
+				else if(strcmp(name, "dram") == 0)
+					open_rapl_domain(&dram_domains[i], subdomain_path);
+			}
+			fclose(name_file);
+		}
+
+		#ifdef DEBUG_HEURISTICS
+		printf("Package %d energy domain opened - core subdomain %s - dram subdomain %s\n", i,
+			core_domains[i].fd < 0 ? "not available" : "available", dram_domains[i].fd < 0 ? "not available" : "available");
+		#endif
+	}
+}
+
+// Returns energy consumption of all packages in micro Joule
+long rapl_get_energy(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i<nb_packages; i++)
+		total_energy += read_rapl_domain(&package_domains[i]);
+
+	return total_energy;
+}
+
+// Returns energy consumption of the cores of all packages in micro Joule, 0 if not available
+long rapl_get_energy_core(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i<nb_packages; i++)
+		total_energy += read_rapl_domain(&core_domains[i]);
+
+	return total_energy;
+}
+
+// Returns energy consumption of the DRAM of all packages in micro Joule, 0 if not available
+long rapl_get_energy_dram(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i<nb_packages; i++)
+		total_energy += read_rapl_domain(&dram_domains[i]);
+
+	return total_energy;
+}
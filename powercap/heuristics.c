@@ -10,90 +10,132 @@
 // Checks if the current config is better than the currently best config and if that's the case update it 
 void update_best_config(double throughput, double power){
 	
-	if(throughput > best_throughput || (best_threads == active_threads && current_pstate <= best_pstate)){
-		best_throughput = throughput;
-		best_pstate = current_pstate;
-		best_threads = active_threads;
-		best_power = power;
+	if(throughput > ctl->best_throughput || (ctl->best_threads == ctl->active_threads && ctl->current_pstate <= ctl->best_pstate)){
+		ctl->best_throughput = throughput;
+		ctl->best_pstate = ctl->current_pstate;
+		ctl->best_threads = ctl->active_threads;
+		ctl->best_power = power;
 	}
 }
 
 int update_level_best_config(double throughput){
-	if(throughput > level_best_throughput){
-		level_best_throughput = throughput;
-		level_best_threads = active_threads;
-		level_best_pstate = current_pstate;
+	if(throughput > ctl->level_best_throughput){
+		ctl->level_best_throughput = throughput;
+		ctl->level_best_threads = ctl->active_threads;
+		ctl->level_best_pstate = ctl->current_pstate;
 		return 1;
 	}
 	else return 0;
 }
 
 void compare_best_level_config(){
-	if(level_best_throughput > best_throughput){
-		best_throughput = level_best_throughput;
-		best_pstate = level_best_pstate;
-		best_threads = level_best_threads;
+	if(ctl->level_best_throughput > ctl->best_throughput){
+		ctl->best_throughput = ctl->level_best_throughput;
+		ctl->best_pstate = ctl->level_best_pstate;
+		ctl->best_threads = ctl->level_best_threads;
 	}
 }
 
 // Stop searching and set the best configuration 
 void stop_searching(){
 
-	decreasing = 0;
-	new_pstate = 1;
-	stopped_searching = 1;
+	ctl->decreasing = 0;
+	ctl->stopped_searching = 1;
 
-	level_best_throughput = 0;
-	level_best_threads = 0;
-	level_best_pstate = 0;
+	ctl->level_best_throughput = 0;
+	ctl->level_best_threads = 0;
+	ctl->level_best_pstate = 0;
 
-	phase0_threads = -1;
-	phase0_pstate = -1;
-	phase = 0;
+	ctl->phase0_threads = -1;
+	ctl->phase0_pstate = -1;
+	ctl->phase = 0;
 
-	current_exploit_steps = 0;
+	ctl->current_exploit_steps = 0;
+	bandit_reset();
+	change_detector_reset();
 
-	if(best_throughput == -1){
-		best_threads = 1;
-		best_pstate = max_pstate;
+	if(ctl->best_throughput == -1){
+		ctl->best_threads = 1;
+		ctl->best_pstate = max_pstate;
 	}
 
-	if(heuristic_mode == 15 && detection_mode == 3){
-		set_pstate(validation_pstate);
+	if(ctl->heuristic_mode == 15 && ctl->detection_mode == 3){
+		set_pstate(ctl->validation_pstate);
 		set_threads(1);
 	}else{
-		set_pstate(best_pstate);
-		set_threads(best_threads);
+		set_pstate(ctl->best_pstate);
+		set_threads(ctl->best_threads);
     }
 
     //Set High and Low for fluctuations when running the model
-    if((heuristic_mode == 15 || heuristic_mode == 10 || heuristic_mode == 16 || heuristic_mode == 13) && detection_mode == 2){
+    if((ctl->heuristic_mode == 15 || ctl->heuristic_mode == 10 || ctl->heuristic_mode == 16 || ctl->heuristic_mode == 13) && (ctl->detection_mode == 2 || ctl->detection_mode == 5)){
 
-    	high_threads = best_threads;
-    	low_threads = best_threads;
+    	ctl->high_threads = ctl->best_threads;
+    	ctl->low_threads = ctl->best_threads;
     	
-    	if(best_pstate > 0)
-    		high_pstate = best_pstate - 1;
-    	else high_pstate = best_pstate;
+    	if(ctl->best_pstate > 0)
+    		ctl->high_pstate = ctl->best_pstate - 1;
+    	else ctl->high_pstate = ctl->best_pstate;
 
     	// Must set dummy value because high was not explored
-    	high_throughput = best_throughput+best_throughput*0.1;
-    	high_power = best_power+best_power*0.1;
+    	ctl->high_throughput = ctl->best_throughput+ctl->best_throughput*0.1;
+    	ctl->high_power = ctl->best_power+ctl->best_power*0.1;
 
-    	if(best_pstate < max_pstate)
-    		low_pstate = best_pstate+1;
-    	else low_pstate = best_pstate;
+    	if(ctl->best_pstate < max_pstate)
+    		ctl->low_pstate = ctl->best_pstate+1;
+    	else ctl->low_pstate = ctl->best_pstate;
     	
     	// Must set dummy value because high was not explored
-    	low_throughput = best_throughput+best_throughput*0.1;
-    	low_power = best_power+best_power*0.1;
+    	ctl->low_throughput = ctl->best_throughput+ctl->best_throughput*0.1;
+    	ctl->low_power = ctl->best_power+ctl->best_power*0.1;
     }
 
+	// The uncore frequency is explored at the best core configuration, lowering it does not increase power consumption
+	if(uncore_scaling && max_uncore_pstate > 0 && !(ctl->heuristic_mode == 15 && ctl->detection_mode == 3)){
+		uncore_searching = 1;
+		uncore_reference_throughput = -1;
+	}
+
 	#ifdef DEBUG_HEURISTICS
-		printf("EXPLORATION COMPLETED IN %d STEPS. OPTIMAL: %d THREADS P-STATE %d\n", steps, best_threads, best_pstate);
+		printf("EXPLORATION COMPLETED IN %d STEPS. OPTIMAL: %d THREADS P-STATE %d\n", ctl->steps, ctl->best_threads, ctl->best_pstate);
 	#endif
 
-	steps = 0; 
+	ctl->steps = 0; 
+}
+
+// Lowers the uncore frequency by one uncore p-state for each round, until the throughput drops more than uncore_tolerance percent
+// below the throughput measured at the uncore p-state where the search started. Then sets the lowest uncore p-state within the tolerance
+void uncore_search(double throughput, double power){
+
+	if(uncore_reference_throughput < 0){
+		uncore_reference_throughput = throughput;
+		uncore_reference_power = power;
+		uncore_reference_pstate = current_uncore_pstate;
+		best_uncore_pstate = current_uncore_pstate;
+	}else if(throughput >= uncore_reference_throughput*(1-uncore_tolerance/100)){
+		best_uncore_pstate = current_uncore_pstate;
+	}else{
+		update_uncore_power_delta(power);
+		set_uncore_pstate(best_uncore_pstate);
+		uncore_searching = 0;
+
+		#ifdef DEBUG_HEURISTICS
+			printf("UNCORE EXPLORATION COMPLETED. OPTIMAL: UNCORE P-STATE %d - %d MHz\n", best_uncore_pstate, uncore_pstate[best_uncore_pstate]/1000);
+		#endif
+		return;
+	}
+
+	update_uncore_power_delta(power);
+
+	if(current_uncore_pstate < max_uncore_pstate){
+		set_uncore_pstate(current_uncore_pstate+1);
+	}else{
+		uncore_searching = 0;
+
+		#ifdef DEBUG_HEURISTICS
+			printf("UNCORE EXPLORATION COMPLETED. OPTIMAL: UNCORE P-STATE %d - %d MHz\n", best_uncore_pstate, uncore_pstate[best_uncore_pstate]/1000);
+		#endif
+	}
 }
 
 
@@ -102,42 +144,42 @@ void stop_searching(){
 // Helper function for dynamic heuristic0, called in phase 0
  static void from_phase0_to_next(){
 	
-	if(best_throughput > 0){
-		phase0_threads = best_threads;
-		phase0_pstate = current_pstate;
+	if(ctl->best_throughput > 0){
+		ctl->phase0_threads = ctl->best_threads;
+		ctl->phase0_pstate = ctl->current_pstate;
 	}
 	else{
-		phase0_threads = 1;
-		phase0_pstate = current_pstate;
+		ctl->phase0_threads = 1;
+		ctl->phase0_pstate = ctl->current_pstate;
 	}
 
-	if(current_pstate == 0){
-		if(best_threads == total_threads){
+	if(ctl->current_pstate == 0){
+		if(ctl->best_threads == total_threads){
 			#ifdef DEBUG_HEURISTICS
 				printf("PHASE 0 -> END\n");
 			#endif
 			stop_searching();
 		}
 		else{
-			phase = 2; 
+			ctl->phase = 2; 
 
-			if(best_throughput > 0){
-				set_threads(best_threads);
-				set_pstate(current_pstate+1);
+			if(ctl->best_throughput > 0){
+				set_threads(ctl->best_threads);
+				set_pstate(ctl->current_pstate+1);
 			}
 
-			level_best_throughput = 0;
-			level_best_threads = 0;
-			level_best_pstate = 0;
+			ctl->level_best_throughput = 0;
+			ctl->level_best_threads = 0;
+			ctl->level_best_pstate = 0;
 			#ifdef DEBUG_HEURISTICS
 				printf("PHASE 0 -> PHASE 2\n");
 			#endif
 		}
 	}else{
-		phase = 1;
-		if(best_throughput > 0){
-			set_threads(best_threads);
-			set_pstate(current_pstate-1);
+		ctl->phase = 1;
+		if(ctl->best_throughput > 0){
+			set_threads(ctl->best_threads);
+			set_pstate(ctl->current_pstate-1);
 		}
 		#ifdef DEBUG_HEURISTICS
 				printf("PHASE 0 -> PHASE 1\n");
@@ -148,21 +190,21 @@ void stop_searching(){
 // Helper function for dynamic heuristic0, called in phase 1
 static void from_phase1_to_next(){
 	// Check if should move to phase 0 or should stop searching 
-	if(phase0_pstate == max_pstate || best_threads == total_threads || phase0_threads == total_threads){
+	if(ctl->phase0_pstate == max_pstate || ctl->best_threads == total_threads || ctl->phase0_threads == total_threads){
 		#ifdef DEBUG_HEURISTICS
 				printf("PHASE 1 -> END\n");
 		#endif
 		stop_searching();
 	}
 	else{
-		phase = 2;
-		if(phase0_threads > 0){
-			set_threads(phase0_threads);
-			set_pstate(phase0_pstate+1);
+		ctl->phase = 2;
+		if(ctl->phase0_threads > 0){
+			set_threads(ctl->phase0_threads);
+			set_pstate(ctl->phase0_pstate+1);
 		}
-		level_best_threads = 0;
-		level_best_throughput = 0;
-		level_best_pstate = 0;
+		ctl->level_best_threads = 0;
+		ctl->level_best_throughput = 0;
+		ctl->level_best_pstate = 0;
 		#ifdef DEBUG_HEURISTICS
 				printf("PHASE 1 -> PHASE 2\n");
 		#endif
@@ -175,19 +217,19 @@ static void from_phase1_to_next(){
 // The exploration at the next p_state always starts from the number of threads found optimal from the previous performance state and only decreases it if needed 
 void dynamic_heuristic0(double throughput, double power){
 	
-	if(phase == 0){	// Thread scheduling at lowest frequency
+	if(ctl->phase == 0){	// Thread scheduling at lowest frequency
 		
-		if(power<power_limit){
+		if(power<ctl->power_limit){
 			update_best_config(throughput, power);
 		}
 
-		if(steps == 0){ // First exploration step
-			if(active_threads != total_threads && power < power_limit){
-				set_threads(active_threads+1);
+		if(ctl->steps == 0){ // First exploration step
+			if(ctl->active_threads != total_threads && power < ctl->power_limit){
+				set_threads(ctl->active_threads+1);
 			}
-			else if(active_threads > 1){
-				decreasing = 1;
-				set_threads(active_threads-1);
+			else if(ctl->active_threads > 1){
+				ctl->decreasing = 1;
+				set_threads(ctl->active_threads-1);
 				
 				#ifdef DEBUG_HEURISTICS
 					printf("PHASE 0 - DECREASING\n");
@@ -197,13 +239,13 @@ void dynamic_heuristic0(double throughput, double power){
 				from_phase0_to_next();
 			}
 		}
-		else if(steps == 1 && !decreasing){ //Second exploration step, define if should set decreasing 
-			if(throughput >= best_throughput*0.9 && power < power_limit && active_threads != total_threads){
-				set_threads(active_threads+1);
+		else if(ctl->steps == 1 && !ctl->decreasing){ //Second exploration step, define if should set decreasing 
+			if(throughput >= ctl->best_throughput*0.9 && power < ctl->power_limit && ctl->active_threads != total_threads){
+				set_threads(ctl->active_threads+1);
 			} else{ // Should set decreasing to 0 
-				if(starting_threads > 1){
-					decreasing = 1; 
-					set_threads(starting_threads-1);	
+				if(ctl->starting_threads > 1){
+					ctl->decreasing = 1; 
+					set_threads(ctl->starting_threads-1);	
 
 					#ifdef DEBUG_HEURISTICS
 						printf("PHASE 0 - DECREASING\n");
@@ -214,17 +256,17 @@ void dynamic_heuristic0(double throughput, double power){
 				}
 			}
 		} 
-		else if(decreasing){ // Decreasing threads  
-			if(throughput < best_throughput*0.9 || active_threads == 1)
+		else if(ctl->decreasing){ // Decreasing threads  
+			if(throughput < ctl->best_throughput*0.9 || ctl->active_threads == 1)
 				from_phase0_to_next();
 			else
-				set_threads(active_threads-1);
+				set_threads(ctl->active_threads-1);
 			
 		} else{ // Increasing threads
-			if( power > power_limit || active_threads == total_threads || throughput < best_throughput*0.9){
-				if(starting_threads > 1){
-					decreasing = 1; 
-					set_threads(starting_threads-1);	
+			if( power > ctl->power_limit || ctl->active_threads == total_threads || throughput < ctl->best_throughput*0.9){
+				if(ctl->starting_threads > 1){
+					ctl->decreasing = 1; 
+					set_threads(ctl->starting_threads-1);	
 
 					#ifdef DEBUG_HEURISTICS
 						printf("PHASE 0 - DECREASING\n");
@@ -234,43 +276,43 @@ void dynamic_heuristic0(double throughput, double power){
 					from_phase0_to_next();
 				}
 			}
-			else set_threads(active_threads+1);
+			else set_threads(ctl->active_threads+1);
 		}
 	}
-	else if(phase == 1){ //Increase in performance states while being within the power cap
+	else if(ctl->phase == 1){ //Increase in performance states while being within the power cap
 		
-		if(power<power_limit){
+		if(power<ctl->power_limit){
 			update_best_config(throughput, power);
 		}
 
-		if( (power < power_limit && current_pstate == 0) || (power > power_limit && active_threads == 1) )
+		if( (power < ctl->power_limit && ctl->current_pstate == 0) || (power > ctl->power_limit && ctl->active_threads == 1) )
 			from_phase1_to_next();
 		
 		else{ // Not yet completed to explore in phase 1 
-			if(power < power_limit) //Should decrease number of active threads
-				set_pstate(current_pstate-1);
+			if(power < ctl->power_limit) //Should decrease number of active threads
+				set_pstate(ctl->current_pstate-1);
 			else // Power beyond power limit
-				set_threads(active_threads-1);
+				set_threads(ctl->active_threads-1);
 		}	
 	}
 	else{ // Phase == 2. Decreasing the CPU frequency and increasing the number of threads. Not called in the first exploration phase 
 		
-		if(power<power_limit){
+		if(power<ctl->power_limit){
 			update_best_config(throughput, power);
 		}
 
-		if( (current_pstate == max_pstate && power>power_limit) || (current_pstate == max_pstate && active_threads == total_threads) || throughput < level_best_throughput || (active_threads == total_threads && power<power_limit ))
+		if( (ctl->current_pstate == max_pstate && power>ctl->power_limit) || (ctl->current_pstate == max_pstate && ctl->active_threads == total_threads) || throughput < ctl->level_best_throughput || (ctl->active_threads == total_threads && power<ctl->power_limit ))
 			stop_searching();
 		else{ // Should still explore in phase 2 
-			if(power < power_limit){
+			if(power < ctl->power_limit){
 				update_level_best_config(throughput);
-				set_threads(active_threads+1);
+				set_threads(ctl->active_threads+1);
 			}
 			else{ // Outside power_limit, should decrease P-state and reset level related data
-				set_pstate(current_pstate+1);
-				level_best_threads = 0;
-				level_best_throughput = 0;
-				level_best_pstate = 0;
+				set_pstate(ctl->current_pstate+1);
+				ctl->level_best_threads = 0;
+				ctl->level_best_throughput = 0;
+				ctl->level_best_pstate = 0;
 			}
 		}
 	}
@@ -279,39 +321,48 @@ void dynamic_heuristic0(double throughput, double power){
 // Utility function used for updating the values of the HIGH configurations
 void update_high(double throughput, double power){
 
-	if(power < power_limit*(1+(extra_range_percentage/100)) && throughput > high_throughput){
-		high_throughput = throughput; 
-		high_pstate = current_pstate;
-		high_threads = active_threads;
-		high_power = power;
+	if(power < ctl->power_limit*(1+(extra_range_percentage/100)) && throughput > ctl->high_throughput){
+		ctl->high_throughput = throughput; 
+		ctl->high_pstate = ctl->current_pstate;
+		ctl->high_threads = ctl->active_threads;
+		ctl->high_power = power;
 	} 
 }
 
 // Utility function used for updating the values of the HIGH configurations
 void update_low(double throughput, double power){
 
-	if( power < power_limit*(1-(extra_range_percentage/100/2)) && throughput > low_throughput){
-		low_throughput = throughput; 
-		low_pstate = current_pstate;
-		low_threads = active_threads; 
-		low_power = power;
+	if( power < ctl->power_limit*(1-(extra_range_percentage/100/2)) && throughput > ctl->low_throughput){
+		ctl->low_throughput = throughput; 
+		ctl->low_pstate = ctl->current_pstate;
+		ctl->low_threads = ctl->active_threads; 
+		ctl->low_power = power;
 	}
 }
 
 // Called by heuristics in-between exploration procedures or model resets
 void perform_fluctuation(double throughput, double power, long time){
 
-	if(fluctuation_state == -1){
-		low_power = power;
-		low_throughput = throughput;
+	if(duty_cycling){
+		duty_cycle_update(throughput, power, time);
+		return;
+	}
+
+	// Running closer to power_limit than the best configuration only pays off for the throughput objective
+	if(ctl->objective != 0)
+		return;
+
+	if(ctl->fluctuation_state == -1){
+		ctl->low_power = power;
+		ctl->low_throughput = throughput;
 	}
-	else if (fluctuation_state == 0){
-		best_power = power;
-		best_throughput = throughput;
+	else if (ctl->fluctuation_state == 0){
+		ctl->best_power = power;
+		ctl->best_throughput = throughput;
 	}
-	else if (fluctuation_state == 1){
-		high_power = power;
-		high_throughput = throughput;
+	else if (ctl->fluctuation_state == 1){
+		ctl->high_power = power;
+		ctl->high_throughput = throughput;
 	}
 	else{
 		printf("Invalid value of fluctuation_state. Aborting execution\n");
@@ -319,101 +370,101 @@ void perform_fluctuation(double throughput, double power, long time){
 	}
 
 	//Update window_power, window_time and update current_window_slot
-	window_power = (window_power*window_time+time*power)/(time+window_time);
-	window_time+=time;
-	current_window_slot++;
+	ctl->window_power = (ctl->window_power*ctl->window_time+time*power)/(time+ctl->window_time);
+	ctl->window_time+=time;
+	ctl->current_window_slot++;
 
 	#ifdef DEBUG_HEURISTICS
-		printf("Window_power = %lf - Slot = %d - Fluctuation_state = %d\n", window_power, current_window_slot, fluctuation_state);
+		printf("Window_power = %lf - Slot = %d - Fluctuation_state = %d\n", ctl->window_power, ctl->current_window_slot, ctl->fluctuation_state);
 	#endif
 
 
-	if(current_window_slot == window_size){ // Last slot in the current window 
-
-		if(window_power < power_limit && best_power < power_limit && high_pstate > 0 && best_pstate > 0 && low_pstate > 0){
-			high_pstate = high_pstate-1;
-			best_pstate = best_pstate-1;
-			low_pstate = low_pstate-1;
-		} else if (window_power > power_limit && low_throughput > 0 && low_power > power_limit && low_pstate < max_pstate && best_pstate < max_pstate && high_pstate < max_pstate){
-			high_pstate = high_pstate+1;
-			best_pstate = best_pstate+1;
-			low_pstate = low_pstate+1;
-		} else if (low_throughput <= 0){
-			if(best_pstate ==  max_pstate)
-				low_pstate = best_pstate;
-			else low_pstate = best_pstate+1;
-			low_threads = best_threads;
-			low_throughput = best_throughput;
+	if(ctl->current_window_slot == window_size){ // Last slot in the current window 
+
+		if(ctl->window_power < ctl->power_limit && ctl->best_power < ctl->power_limit && ctl->high_pstate > 0 && ctl->best_pstate > 0 && ctl->low_pstate > 0){
+			ctl->high_pstate = ctl->high_pstate-1;
+			ctl->best_pstate = ctl->best_pstate-1;
+			ctl->low_pstate = ctl->low_pstate-1;
+		} else if (ctl->window_power > ctl->power_limit && ctl->low_throughput > 0 && ctl->low_power > ctl->power_limit && ctl->low_pstate < max_pstate && ctl->best_pstate < max_pstate && ctl->high_pstate < max_pstate){
+			ctl->high_pstate = ctl->high_pstate+1;
+			ctl->best_pstate = ctl->best_pstate+1;
+			ctl->low_pstate = ctl->low_pstate+1;
+		} else if (ctl->low_throughput <= 0){
+			if(ctl->best_pstate ==  max_pstate)
+				ctl->low_pstate = ctl->best_pstate;
+			else ctl->low_pstate = ctl->best_pstate+1;
+			ctl->low_threads = ctl->best_threads;
+			ctl->low_throughput = ctl->best_throughput;
 		}
 		else{
-			if(high_throughput < best_throughput || (best_threads == high_threads && best_pstate == high_pstate)){
-				if(best_pstate != 0 )
-					high_pstate = best_pstate-1;
-				else high_pstate = best_pstate;
-				high_threads = best_threads;
-				high_throughput = throughput;
+			if(ctl->high_throughput < ctl->best_throughput || (ctl->best_threads == ctl->high_threads && ctl->best_pstate == ctl->high_pstate)){
+				if(ctl->best_pstate != 0 )
+					ctl->high_pstate = ctl->best_pstate-1;
+				else ctl->high_pstate = ctl->best_pstate;
+				ctl->high_threads = ctl->best_threads;
+				ctl->high_throughput = throughput;
 			}
 
-			if(low_throughput == 0 || (best_threads == low_threads && best_pstate == low_pstate)){
-				if(best_pstate != max_pstate && best_power > power_limit)
-					low_pstate = best_pstate+1;
-				else low_pstate = best_pstate;
-				low_threads = best_threads;
-				low_throughput = best_throughput;
+			if(ctl->low_throughput == 0 || (ctl->best_threads == ctl->low_threads && ctl->best_pstate == ctl->low_pstate)){
+				if(ctl->best_pstate != max_pstate && ctl->best_power > ctl->power_limit)
+					ctl->low_pstate = ctl->best_pstate+1;
+				else ctl->low_pstate = ctl->best_pstate;
+				ctl->low_threads = ctl->best_threads;
+				ctl->low_throughput = ctl->best_throughput;
 			}
 		}
 
-		set_threads(best_threads);
-		set_pstate(best_pstate);
-		fluctuation_state = 0;
+		set_threads(ctl->best_threads);
+		set_pstate(ctl->best_pstate);
+		ctl->fluctuation_state = 0;
 
-		window_time = 0;
-		window_power = 0;
-		current_window_slot = 0;
+		ctl->window_time = 0;
+		ctl->window_power = 0;
+		ctl->current_window_slot = 0;
 
 
 
 		#ifdef DEBUG_HEURISTICS
 			printf(" - Next configuration = BEST (restart)\n");
-			printf("BEST - threads %d - pstate %d - power %lf\n", best_threads, best_pstate, best_power);
-			printf("HIGH - threads %d - pstate %d - power %lf\n", high_threads, high_pstate, high_power);
-			printf("LOW - threads %d - pstate %d - power %lf\n", low_threads, low_pstate, low_power);
+			printf("BEST - threads %d - pstate %d - power %lf\n", ctl->best_threads, ctl->best_pstate, ctl->best_power);
+			printf("HIGH - threads %d - pstate %d - power %lf\n", ctl->high_threads, ctl->high_pstate, ctl->high_power);
+			printf("LOW - threads %d - pstate %d - power %lf\n", ctl->low_threads, ctl->low_pstate, ctl->low_power);
 		#endif
 	}
 	else{ // Regular slot, should decide configuration for next step 
-		if(window_power < power_limit*(1-hysteresis/100)){	// Should increase_window_power
-			if(best_power > power_limit || (high_throughput == -1)){
-				set_threads(best_threads);
-				set_pstate(best_pstate);
-				fluctuation_state = 0;
+		if(ctl->window_power < ctl->power_limit*(1-hysteresis/100)){	// Should increase_window_power
+			if(ctl->best_power > ctl->power_limit || (ctl->high_throughput == -1)){
+				set_threads(ctl->best_threads);
+				set_pstate(ctl->best_pstate);
+				ctl->fluctuation_state = 0;
 				
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = BEST\n");
 				#endif
 			}
 			else {
-				set_threads(high_threads);
-				set_pstate(high_pstate);
-				fluctuation_state = 1;
+				set_threads(ctl->high_threads);
+				set_pstate(ctl->high_pstate);
+				ctl->fluctuation_state = 1;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = HIGH\n");
 				#endif
 			}
-		}else if (window_power > power_limit*(1+hysteresis/100)){ // Should decrease window_power
-			if(best_power < power_limit || (low_throughput == -1)){
-				set_threads(best_threads);
-				set_pstate(best_pstate);
-				fluctuation_state = 0;
+		}else if (ctl->window_power > ctl->power_limit*(1+hysteresis/100)){ // Should decrease window_power
+			if(ctl->best_power < ctl->power_limit || (ctl->low_throughput == -1)){
+				set_threads(ctl->best_threads);
+				set_pstate(ctl->best_pstate);
+				ctl->fluctuation_state = 0;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = BEST\n");
 				#endif
 			}
 			else {
-				set_threads(low_threads);
-				set_pstate(low_pstate);
-				fluctuation_state = -1;
+				set_threads(ctl->low_threads);
+				set_pstate(ctl->low_pstate);
+				ctl->fluctuation_state = -1;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = LOW\n");
@@ -421,26 +472,26 @@ void perform_fluctuation(double throughput, double power, long time){
 			}
 		}
 		else{	// Window_power is within the hysteresis variation of window_power
-			if(high_power < power_limit*(1+hysteresis/100) && high_throughput != -1){
-				set_threads(high_threads);
-				set_pstate(high_pstate);
-				fluctuation_state = 1;
+			if(ctl->high_power < ctl->power_limit*(1+hysteresis/100) && ctl->high_throughput != -1){
+				set_threads(ctl->high_threads);
+				set_pstate(ctl->high_pstate);
+				ctl->fluctuation_state = 1;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = HIGH (hysteresis)\n");
 				#endif
-			}else if(best_power < power_limit*(1+hysteresis/100) || low_throughput == -1){
-				set_threads(best_threads);
-				set_pstate(best_pstate);
-				fluctuation_state = 0;
+			}else if(ctl->best_power < ctl->power_limit*(1+hysteresis/100) || ctl->low_throughput == -1){
+				set_threads(ctl->best_threads);
+				set_pstate(ctl->best_pstate);
+				ctl->fluctuation_state = 0;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = BEST (hysteresis)\n");
 				#endif
 			}else{
-				set_threads(low_threads);
-				set_pstate(low_pstate);
-				fluctuation_state = -1;
+				set_threads(ctl->low_threads);
+				set_pstate(ctl->low_pstate);
+				ctl->fluctuation_state = -1;
 
 				#ifdef DEBUG_HEURISTICS
 					printf(" - Next configuration = LOW (hysteresis)\n");
@@ -463,18 +514,18 @@ void dynamic_heuristic1(double throughput, double power){
 
 void update_highest_threads(double throughput, double power){
 	
-	if( power < power_limit){
-		if(active_threads == best_threads){
-			if(best_pstate == -1 || current_pstate < best_pstate){
-				best_throughput = throughput;
-				best_threads = active_threads;
-				best_pstate = current_pstate;
+	if( power < ctl->power_limit){
+		if(ctl->active_threads == ctl->best_threads){
+			if(ctl->best_pstate == -1 || ctl->current_pstate < ctl->best_pstate){
+				ctl->best_throughput = throughput;
+				ctl->best_threads = ctl->active_threads;
+				ctl->best_pstate = ctl->current_pstate;
 			}
 		}
-		else if( active_threads > best_threads){
-			best_throughput = throughput;
-			best_threads = active_threads;
-			best_pstate = current_pstate;
+		else if( ctl->active_threads > ctl->best_threads){
+			ctl->best_throughput = throughput;
+			ctl->best_threads = ctl->active_threads;
+			ctl->best_pstate = ctl->current_pstate;
 		}					
 	}
 }
@@ -484,36 +535,40 @@ void heuristic_highest_threads(double throughput, double power){
 	
 	update_highest_threads(throughput, power);
 
-	if(phase == 0){	// Find the highest number of threads at the lowest P-state
-		if(steps == 0){
-			if(active_threads == total_threads || power > power_limit){
-				decreasing = 1; 
-				set_threads(active_threads-1);
+	if(ctl->phase == 0){	// Find the highest number of threads at the lowest P-state
+		if(ctl->steps == 0){
+			if(ctl->active_threads == 1 && power > ctl->power_limit)
+				stop_searching();	// A restart from 1 thread above the limit, stop_searching() falls back to the lowest configuration
+			else if(ctl->active_threads == total_threads || power > ctl->power_limit){
+				ctl->decreasing = 1; 
+				set_threads(ctl->active_threads-1);
 			}
 			else 
-				set_threads(active_threads+1);
+				set_threads(ctl->active_threads+1);
 		}else{
-			if(decreasing){
-				if(power < power_limit){
-					if(best_pstate != 0){
-						phase = 1; 
-						set_threads(best_threads);
-						set_pstate(best_pstate-1);
+			if(ctl->decreasing){
+				if(power < ctl->power_limit){
+					if(ctl->best_pstate != 0){
+						ctl->phase = 1; 
+						set_threads(ctl->best_threads);
+						set_pstate(ctl->best_pstate-1);
 					}else stop_searching();
-				} else set_threads(active_threads-1);
+				}else if(ctl->active_threads == 1)
+					stop_searching();
+				else set_threads(ctl->active_threads-1);
 			}else{	//Increasing
-				if( power > power_limit || active_threads == total_threads){
-					phase = 1;
-					set_threads(best_threads);
-					set_pstate(best_pstate-1);
-				} else set_threads(active_threads+1);
+				if( power > ctl->power_limit || ctl->active_threads == total_threads){
+					ctl->phase = 1;
+					set_threads(ctl->best_threads);
+					set_pstate(ctl->best_pstate-1);
+				} else set_threads(ctl->active_threads+1);
 			}
 		}
 	}
-	else if (phase == 1){
-		if(power > power_limit || current_pstate == 0 )
+	else if (ctl->phase == 1){
+		if(power > ctl->power_limit || ctl->current_pstate == 0 )
 			stop_searching();
-		else set_pstate(current_pstate-1);
+		else set_pstate(ctl->current_pstate-1);
 	}
 }
 	
@@ -522,17 +577,17 @@ void heuristic_highest_threads(double throughput, double power){
 // When this policy is set, the exploration starts with 1 thread at the maximum p-state
 void heuristic_binary_search(double throughput, double power){
 
-	if(phase == 0){ // Thread tuning
+	if(ctl->phase == 0){ // Thread tuning
 
 		// First two steps should check performance results with lowest number of active threads (1) and highest. If the latter performs worse than then former should directly move to DVFS tuning
-		if(steps == 0){
-			min_thread_search_throughput = throughput;
+		if(ctl->steps == 0){
+			ctl->min_thread_search_throughput = throughput;
 			set_threads(total_threads);
-			steps++;
-		}else if(steps == 1){
-			max_thread_search_throughput = throughput;
-			if(max_thread_search_throughput < min_thread_search_throughput){
-				phase = 1;
+			ctl->steps++;
+		}else if(ctl->steps == 1){
+			ctl->max_thread_search_throughput = throughput;
+			if(ctl->max_thread_search_throughput < ctl->min_thread_search_throughput){
+				ctl->phase = 1;
 				set_threads(1);
 				set_pstate((int) max_pstate/2);
 
@@ -540,10 +595,10 @@ void heuristic_binary_search(double throughput, double power){
 					printf("PHASE 0 --> PHASE 1\n");
 				#endif
 
-			}else set_threads(min_thread_search+((int) (max_thread_search - min_thread_search) /2));
+			}else set_threads(ctl->min_thread_search+((int) (ctl->max_thread_search - ctl->min_thread_search) /2));
 		}else{ 	
-			if(min_thread_search >= max_thread_search){ // Stop the binary search on threads and move on dvfs
-				phase = 1; 
+			if(ctl->min_thread_search >= ctl->max_thread_search){ // Stop the binary search on threads and move on dvfs
+				ctl->phase = 1; 
 				set_pstate((int) max_pstate/2);
 
 				#ifdef DEBUG_HEURISTICS
@@ -551,24 +606,24 @@ void heuristic_binary_search(double throughput, double power){
 				#endif
 
 			}else{ // Keep searching
-				if(power > power_limit || throughput > max_thread_search_throughput){ // Should set current to high
-					max_thread_search = active_threads;
-					max_thread_search_throughput = throughput; 
+				if(power > ctl->power_limit || throughput > ctl->max_thread_search_throughput){ // Should set current to high
+					ctl->max_thread_search = ctl->active_threads;
+					ctl->max_thread_search_throughput = throughput; 
 				}else{ // Should set current to low 
-					min_thread_search = active_threads;
-					min_thread_search_throughput = throughput; 
+					ctl->min_thread_search = ctl->active_threads;
+					ctl->min_thread_search_throughput = throughput; 
 				}
-				set_threads(min_thread_search+((int) (max_thread_search - min_thread_search) /2));
+				set_threads(ctl->min_thread_search+((int) (ctl->max_thread_search - ctl->min_thread_search) /2));
 			}
 		}
 		
 		#ifdef DEBUG_HEURISTICS
-			printf("SEARCH RANGE - THREADS: %d - %d \n", min_thread_search, max_thread_search);
+			printf("SEARCH RANGE - THREADS: %d - %d \n", ctl->min_thread_search, ctl->max_thread_search);
 		#endif
 
 	}else{ // DVFS tuning, phase == 1 
 
-		if(min_pstate_search >= max_pstate_search){
+		if(ctl->min_pstate_search >= ctl->max_pstate_search){
 			
 			#ifdef DEBUG_HEURISTICS
 					printf("PHASE 1 --> END\n");
@@ -578,15 +633,15 @@ void heuristic_binary_search(double throughput, double power){
 			update_best_config(throughput, power);
 			stop_searching();
 		}else{ 	// Decreasing the p-state always improves performance
-			if(power < power_limit) 
-				max_pstate_search = current_pstate;
-			else min_pstate_search = current_pstate;
+			if(power < ctl->power_limit) 
+				ctl->max_pstate_search = ctl->current_pstate;
+			else ctl->min_pstate_search = ctl->current_pstate;
 
-			set_pstate(min_pstate_search+( (int) ceil(((double) max_pstate_search - (double) min_pstate_search)/2)));
+			set_pstate(ctl->min_pstate_search+( (int) ceil(((double) ctl->max_pstate_search - (double) ctl->min_pstate_search)/2)));
 		}
 
 		#ifdef DEBUG_HEURISTICS
-			printf("SEARCH RANGE - P-STATE: %d - %d \n", min_pstate_search, max_pstate_search);
+			printf("SEARCH RANGE - P-STATE: %d - %d \n", ctl->min_pstate_search, ctl->max_pstate_search);
 		#endif
 	}
 }
@@ -595,23 +650,23 @@ void heuristic_binary_search(double throughput, double power){
 // if either performance decreases or the power consumption reaches the power limit, it to phase 2 where the DVFS setting, for that given amount of active threads, is tuned
 void heuristic_two_step_search(double throughput, double power){
 
-	if(power<power_limit){
+	if(power<ctl->power_limit){
 		update_best_config(throughput,power);
 	}
 
-	if(phase == 0){ // Searching threads
-		if(power<power_limit && active_threads < total_threads && throughput > best_throughput*0.9){
-			set_threads(active_threads+1);
+	if(ctl->phase == 0){ // Searching threads
+		if(power<ctl->power_limit && ctl->active_threads < total_threads && throughput > ctl->best_throughput*0.9){
+			set_threads(ctl->active_threads+1);
 		}else{
-			if(best_throughput != -1){
-				set_threads(best_threads);
+			if(ctl->best_throughput != -1){
+				set_threads(ctl->best_threads);
 			}
-			set_pstate(current_pstate-1);
-			phase = 1; 
+			set_pstate(ctl->current_pstate-1);
+			ctl->phase = 1; 
 		}
 	}else{ // Phase == 1. Optimizing DVFS
-		if(power<power_limit && current_pstate > 0){
-			set_pstate(current_pstate-1);
+		if(power<ctl->power_limit && ctl->current_pstate > 0){
+			set_pstate(ctl->current_pstate-1);
 		}
 		else{
 			stop_searching();
@@ -623,17 +678,17 @@ void heuristic_two_step_search(double throughput, double power){
 // Helper function for dynamic heuristic0, called in phase 0
 static void from_phase0_to_next_stateful(){
 
-	phase == 1;
+	ctl->phase == 1;
 
-	if(best_throughput == -1){
-		set_pstate(current_pstate+1);
+	if(ctl->best_throughput == -1){
+		set_pstate(ctl->current_pstate+1);
 	}else{
 
-		if(current_pstate == 0)
+		if(ctl->current_pstate == 0)
 			stop_searching();
 		else{
-			set_threads(best_threads);
-			set_pstate(current_pstate-1);
+			set_threads(ctl->best_threads);
+			set_pstate(ctl->current_pstate-1);
 		}
 	} 
 }
@@ -641,19 +696,19 @@ static void from_phase0_to_next_stateful(){
 // Equivalent to heuristic_two_step_search but when the exploration is restarted it starts from the previous best configuration instead of 1 Thread at lowest DVFS setting. 
 void heuristic_two_step_stateful(double throughput, double power){
 	
-	if(phase == 0){	// Thread scheduling at lowest frequency
+	if(ctl->phase == 0){	// Thread scheduling at lowest frequency
 		
-		if(power<power_limit){
+		if(power<ctl->power_limit){
 			update_best_config(throughput, power);
 		}
 
-		if(steps == 0){ // First exploration step
-			if(active_threads != total_threads && power < power_limit){
-				set_threads(active_threads+1);
+		if(ctl->steps == 0){ // First exploration step
+			if(ctl->active_threads != total_threads && power < ctl->power_limit){
+				set_threads(ctl->active_threads+1);
 			}
-			else if(active_threads > 1){
-				decreasing = 1;
-				set_threads(active_threads-1);
+			else if(ctl->active_threads > 1){
+				ctl->decreasing = 1;
+				set_threads(ctl->active_threads-1);
 				
 				#ifdef DEBUG_HEURISTICS
 					printf("PHASE 0 - DECREASING\n");
@@ -663,13 +718,13 @@ void heuristic_two_step_stateful(double throughput, double power){
 				from_phase0_to_next_stateful();
 			}
 		}
-		else if(steps == 1 && !decreasing){ //Second exploration step, define if should set decreasing 
-			if(throughput >= best_throughput*0.9 && power < power_limit && active_threads != total_threads){
-				set_threads(active_threads+1);
+		else if(ctl->steps == 1 && !ctl->decreasing){ //Second exploration step, define if should set decreasing 
+			if(throughput >= ctl->best_throughput*0.9 && power < ctl->power_limit && ctl->active_threads != total_threads){
+				set_threads(ctl->active_threads+1);
 			} else{ // Should set decreasing to 0 
-				if(starting_threads > 1){
-					decreasing = 1; 
-					set_threads(starting_threads-1);	
+				if(ctl->starting_threads > 1){
+					ctl->decreasing = 1; 
+					set_threads(ctl->starting_threads-1);	
 
 					#ifdef DEBUG_HEURISTICS
 						printf("PHASE 0 - DECREASING\n");
@@ -680,17 +735,17 @@ void heuristic_two_step_stateful(double throughput, double power){
 				}
 			}
 		} 
-		else if(decreasing){ // Decreasing threads  
-			if(throughput < best_throughput*0.9 || active_threads == 1)
+		else if(ctl->decreasing){ // Decreasing threads  
+			if(throughput < ctl->best_throughput*0.9 || ctl->active_threads == 1)
 				from_phase0_to_next_stateful();
 			else
-				set_threads(active_threads-1);
+				set_threads(ctl->active_threads-1);
 			
 		} else{ // Increasing threads
-			if( power > power_limit || active_threads == total_threads || throughput < best_throughput*0.9){
-				if(starting_threads > 1){
-					decreasing = 1; 
-					set_threads(starting_threads-1);	
+			if( power > ctl->power_limit || ctl->active_threads == total_threads || throughput < ctl->best_throughput*0.9){
+				if(ctl->starting_threads > 1){
+					ctl->decreasing = 1; 
+					set_threads(ctl->starting_threads-1);	
 
 					#ifdef DEBUG_HEURISTICS
 						printf("PHASE 0 - DECREASING\n");
@@ -700,16 +755,16 @@ void heuristic_two_step_stateful(double throughput, double power){
 					from_phase0_to_next_stateful();
 				}
 			}
-			else set_threads(active_threads+1);
+			else set_threads(ctl->active_threads+1);
 		}
 	}
 	else{ // Phase == 1 -> Increase DVFS until reaching the powercap
 		
-		if(power<power_limit){
+		if(power<ctl->power_limit){
 			update_best_config(throughput, power);
 		}
 
-		if( (power < power_limit && current_pstate == 0) || (power > power_limit && active_threads == 1) ){
+		if( (power < ctl->power_limit && ctl->current_pstate == 0) || (power > ctl->power_limit && ctl->active_threads == 1) ){
 		
 			#ifdef DEBUG_HEURISTICS
 				printf("PHASE 1 - END\n");
@@ -717,12 +772,12 @@ void heuristic_two_step_stateful(double throughput, double power){
 			
 			stop_searching();;
 		} else{ // Not yet completed to explore in phase 1 
-			if(power < power_limit)
-				set_pstate(current_pstate-1);
+			if(power < ctl->power_limit)
+				set_pstate(ctl->current_pstate-1);
 			else{
 
-				if(best_throughput == -1)
-					set_pstate(current_pstate+1);
+				if(ctl->best_throughput == -1)
+					set_pstate(ctl->current_pstate+1);
 				else{
 					#ifdef DEBUG_HEURISTICS
 						printf("PHASE 1 - END\n");
@@ -736,44 +791,26 @@ void heuristic_two_step_stateful(double throughput, double power){
 	}
 }
 
+// Fills power_model with the predictions of the online model, used by the model validation of detection mode 3
 void compute_power_model(){
 
-	double alfa, beta, pwr_h, pwr_l, freq_h, freq_l, freq_i, freq3_h, freq3_l;
 	int i,j; 
 
-	freq_h = ((double) pstate[lower_sampled_model_pstate])/1000;
-	freq_l = ((double) pstate[max_pstate])/1000;
-
-	freq3_h = freq_h*freq_h*freq_h;
-	freq3_l = freq_l*freq_l*freq_l;
-
-	// Must compute specific model instance for each number of active threads
 	for(j = 1; j <= total_threads; j++){
-		
-		pwr_h = power_model[lower_sampled_model_pstate][j] - power_uncore;
-		pwr_l = power_model[max_pstate][j] - power_uncore;
-		
-		alfa = (pwr_l*freq_h - pwr_h*freq_l)/(freq_h*freq3_l - freq3_h*freq_l);
-		beta = (pwr_l*freq_h*freq_h*freq_h - pwr_h*freq_l*freq_l*freq_l)/(freq_h*freq_h*freq_h*freq_l - freq_h*freq_l*freq_l*freq_l);
 
 		#ifdef DEBUG_HEURISTICS
-			printf("Setting up the power model ...\n");
-			printf("Threads = %d - alfa = %lf - beta = %lf - power uncore = %lf - pwr_h = %lf - pwr_l = %lf - freq_h %lf - freq3_h %lf\n", 
-				j, alfa, beta, power_uncore, pwr_h, pwr_l, freq_h, freq3_h);
+			printf("Threads = %d - alfa = %lf - beta = %lf - power uncore = %lf - samples = %ld\n", 
+				j, ctl->model->power_rls[j].theta[0], ctl->model->power_rls[j].theta[1], get_uncore_power(current_uncore_pstate), ctl->model->power_rls[j].samples);
 		#endif
 		
-		for(i = 1; i < max_pstate; i++) {
-			if (i==lower_sampled_model_pstate) continue;
-			freq_i = ((double) pstate[i])/1000;
-			power_model[i][j] = alfa*freq_i*freq_i*freq_i+beta*freq_i+power_uncore; 
-		}
-		
+		for(i = 1; i <= max_pstate; i++)
+			ctl->power_model[i][j] = model_power(i, j); 
 	}
 
 	#ifdef DEBUG_HEURISTICS
 		for(i = 1; i <= max_pstate; i++){
 			for (j = 1; j <= total_threads; j++){
-				printf("%lf\t", power_model[i][j]);
+				printf("%lf (+-%lf)\t", ctl->power_model[i][j], model_power_stddev(i, j));
 			}
 			printf("\n");
 		}
@@ -781,33 +818,25 @@ void compute_power_model(){
 	#endif
 }
 
+// Fills throughput_model with the predictions of the online model, used by the model validation of detection mode 3
 void compute_throughput_model(){
 
-	double c,m,speedup; 
 	int i,j; 
 
-	// Must compute specific model instance for each number of active threads
 	for(j = 1; j <= total_threads; j++){
-		speedup = throughput_model[lower_sampled_model_pstate][j]/throughput_model[max_pstate][j];
-		c = (pstate[lower_sampled_model_pstate]*(1-speedup))/(speedup*(pstate[max_pstate]-pstate[lower_sampled_model_pstate]));
-		m = 1-c;
 
 		#ifdef DEBUG_HEURISTICS
-			printf("Setting up the throughput model ...\n");
-			printf("Threads = %d - C = %lf - M = %lf - speedup = %lf\n", j, c, m, speedup);
+			printf("Threads = %d - a = %lf - b = %lf - samples = %ld\n", j, ctl->model->throughput_rls[j].theta[0], ctl->model->throughput_rls[j].theta[1], ctl->model->throughput_rls[j].samples);
 		#endif
 		
-		for(i = 1; i < max_pstate; i++) {
-			if (i==lower_sampled_model_pstate) continue;
-			throughput_model[i][j] = (1/(((double) pstate[max_pstate] * 1000)/((double) pstate[i] * 1000)*c+m))*throughput_model[max_pstate][j];
-		}
-		
+		for(i = 1; i <= max_pstate; i++)
+			ctl->throughput_model[i][j] = model_throughput(i, j);
 	}
 
 	#ifdef DEBUG_HEURISTICS
 		for(i = 1; i <= max_pstate; i++){
 			for (j = 1; j <= total_threads; j++){
-				printf("%lf\t", throughput_model[i][j]);
+				printf("%lf (+-%lf)\t", ctl->throughput_model[i][j], model_throughput_stddev(i, j));
 			}
 			printf("\n");
 		}
@@ -815,56 +844,72 @@ void compute_throughput_model(){
 	#endif
 }
 
+// Selects the configuration with the highest predicted score of the objective among the ones with predicted power lower than power_limit
+void select_model_best_config(){
 
-// Relies on power and performance models to predict power and performance.The setup of the models
-// require to sample power and performance of all configurations with P-state = 1 and P-state = max_pstate.
-// In the initial phase, the setup is performed. Consequently, the models are used to selects the best configuration
-// under the power cap based on their predictions. 
+	int i, j;
+	double score;
+
+	// As in the other heuristics, best_throughput holds the score of the objective rather than the raw throughput
+	ctl->best_threads = 1;
+	ctl->best_pstate = max_pstate;
+	ctl->best_throughput = objective_score(model_throughput(max_pstate, 1), model_power(max_pstate, 1));
+
+	for(i = 1; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			score = objective_score(model_throughput(i, j), model_power(i, j));
+			if(model_power(i, j) < ctl->power_limit && score > ctl->best_throughput){
+				ctl->best_pstate = i;
+				ctl->best_threads = j;
+				ctl->best_throughput = score;
+			}
+		}
+	}
+}
+
+
+// Relies on power and performance models to predict power and performance. The setup of the models
+// requires to sample power and performance of all configurations with P-state = lower_sampled_model_pstate and P-state = max_pstate,
+// or only of a subset of the thread counts with model_sampled_threads, the others being interpolated.
+// Every sample is added to the online models of model.c, which keep learning after the setup. Once the setup is completed,
+// the models are used to select the best configuration under the power cap based on their predictions. 
 void model_power_throughput(double throughput, double power){
 
-	int i, j;
+	int slot = ctl->current_pstate == max_pstate ? 0 : 1;
+	int next_threads;
 
-	power_model[current_pstate][active_threads] = power;
-	throughput_model[current_pstate][active_threads] = throughput;
+	model_add_sample(ctl->current_pstate, ctl->active_threads, throughput, power);
+	model_record_setup_sample(slot, ctl->active_threads, throughput, power);
 
-	if(current_pstate == max_pstate){
-		power_real[current_pstate][active_threads] = power;
-		throughput_real[current_pstate][active_threads] = throughput;
-		power_validation[current_pstate][active_threads] = power_model[current_pstate][active_threads];
-		throughput_validation[current_pstate][active_threads] = throughput_model[current_pstate][active_threads];
+	if(ctl->current_pstate == max_pstate){
+		ctl->power_real[ctl->current_pstate][ctl->active_threads] = power;
+		ctl->throughput_real[ctl->current_pstate][ctl->active_threads] = throughput;
+		ctl->power_validation[ctl->current_pstate][ctl->active_threads] = model_power(ctl->current_pstate, ctl->active_threads);
+		ctl->throughput_validation[ctl->current_pstate][ctl->active_threads] = model_throughput(ctl->current_pstate, ctl->active_threads);
 	}
 
-	if(active_threads == total_threads && current_pstate == lower_sampled_model_pstate){
-		
-		compute_power_model();
-		compute_throughput_model();
-
-		// Init best_threads and best_pstate
-		best_threads = 1;
-		best_pstate = max_pstate;
-		best_throughput = throughput_model[max_pstate][1];
+	next_threads = model_next_threads(slot);
 
-		for(i = 1; i <= max_pstate; i++){
-			for(j = 1; j <= total_threads; j++){
-				if(power_model[i][j] < power_limit && throughput_model[i][j] > best_throughput){
-					best_pstate = i;
-					best_threads = j;
-					best_throughput = throughput_model[i][j];
-				}
-			}
-		}
-		
-		stop_searching();
+	if(next_threads > 0){
+		set_threads(next_threads);
+	}else if(slot == 0){
+		model_interpolate_threads(max_pstate, 0);
+		set_pstate(lower_sampled_model_pstate);
+		set_threads(model_next_threads(1));
+	}else{
+		model_interpolate_threads(lower_sampled_model_pstate, 1);
+		ctl->model_setup_rounds_sum += ctl->model_setup_rounds;
+		ctl->model_setups++;
 
-	}else{ 
+		#ifdef DEBUG_HEURISTICS
+			printf("Model setup completed in %d rounds\n", ctl->model_setup_rounds);
+		#endif
 
-		if(active_threads < total_threads)
-			set_threads(active_threads+1);
-		else{
-			set_pstate(lower_sampled_model_pstate);
-			set_threads(1);
-		}
-	} 
+		compute_power_model();
+		compute_throughput_model();
+		select_model_best_config();
+		stop_searching();
+	}
 }
 
 void baseline_enhanced(double throughput, double power){
@@ -881,6 +926,62 @@ char* subString (const char* input, int offset, int len, char* dest){
   	return dest;
 }
 
+// Restarts the exploration from the initial configuration of the heuristic, used by the detection modes
+void restart_exploration(){
+
+	duty_cycle_reset();
+
+	#ifdef DEBUG_HEURISTICS
+		printf("EXPLORATION RESTARTED. PHASE 0 - INITIAL CONFIGURATION: #threads %d - p_state %d\n", ctl->best_threads, ctl->best_pstate);
+	#endif
+
+	if(ctl->heuristic_mode == 11){
+		set_pstate(max_pstate);
+		set_threads(ctl->starting_threads);
+	}else if(ctl->heuristic_mode == 12 || ctl->heuristic_mode == 13 || ctl->heuristic_mode == 15 || ctl->heuristic_mode == 17 || ctl->heuristic_mode == 18){
+		set_pstate(max_pstate);
+		set_threads(1);
+	}else{
+		set_pstate(ctl->best_pstate);
+		set_threads(ctl->best_threads);
+		ctl->starting_threads = ctl->best_threads;
+	}
+
+	// The core configuration is explored at the highest uncore frequency
+	set_uncore_pstate(0);
+
+	ctl->best_throughput = -1;
+	ctl->best_pstate = -1; 
+	ctl->best_threads = -1;
+	ctl->best_power = -1;
+
+	ctl->high_throughput = -1;
+	ctl->high_pstate = -1;
+	ctl->high_threads = -1;
+	ctl->high_power = -1;
+
+	ctl->low_throughput = -1;
+	ctl->low_pstate = -1;
+	ctl->low_threads = -1;
+	ctl->low_power = -1;
+
+	ctl->fluctuation_state = 0;
+	ctl->window_time = 0;
+	ctl->window_power = 0;
+	ctl->current_window_slot = 0;
+
+	ctl->stopped_searching = 0;
+
+	ctl->min_thread_search = 1;
+	ctl->max_thread_search = total_threads;
+
+	ctl->min_pstate_search = 0; 
+	ctl->max_pstate_search = max_pstate;
+
+	ctl->min_thread_search_throughput = -1;
+	ctl->max_thread_search_throughput = -1;
+}
+
 ///////////////////////////////////////////////////////////////
 // Main heuristic function
 ///////////////////////////////////////////////////////////////
@@ -888,41 +989,49 @@ char* subString (const char* input, int offset, int len, char* dest){
 
 
 
-// Takes decision on frequency and number of active threads based on statistics of current round 
-void heuristic(double throughput, double power, long time){
-	
-	#ifdef DEBUG_HEURISTICS
-		printf("Heuristic called - throughput: %lf - power: %lf Watt - time_interval %lf ms\n", throughput, power, ((double) time)/1000000);
-	#endif
+// Takes decision on frequency and number of active threads of the selected controller based on statistics of current round 
+void controller_step(double throughput, double power, long time){
+
+	double score = objective_score(throughput, power);	// Replaces the throughput for the heuristics that compare measured configurations
 
-	if(!stopped_searching){
-		switch(heuristic_mode){
+	// Rounds alternating two p-states with duty cycling are not samples of a single configuration
+	if(!duty_cycle_active())
+		pareto_add_sample(ctl->current_pstate, ctl->active_threads, throughput, power);
+
+	if(!ctl->stopped_searching){
+		switch(ctl->heuristic_mode){
 			case 8: // Fixed number of threads at p_state static_pstate set in hope_config.txt
-				stopped_searching = 1;
+				ctl->stopped_searching = 1;
 				break;
 			case 9:	// Dynamic heuristic0
-				dynamic_heuristic0(throughput, power);
+				dynamic_heuristic0(score, power);
 				break;
 			case 10: 
-				dynamic_heuristic1(throughput, power);
+				dynamic_heuristic1(score, power);
 				break;
 			case 11:
-				heuristic_highest_threads(throughput, power);
+				heuristic_highest_threads(score, power);
 				break;
 			case 12:
-				heuristic_binary_search(throughput,power);
+				heuristic_binary_search(score,power);
 				break;
 			case 13:
-				heuristic_two_step_search(throughput, power);
+				heuristic_two_step_search(score, power);
 				break;
 			case 14:
-				heuristic_two_step_stateful(throughput, power);
+				heuristic_two_step_stateful(score, power);
 				break;
 			case 15:
 				model_power_throughput(throughput, power);
 				break;
 			case 16:
-				baseline_enhanced(throughput, power);
+				baseline_enhanced(score, power);
+				break;
+			case 17:
+				heuristic_bayesian(score, power);
+				break;
+			case 18:
+				heuristic_mpc(throughput, power);
 				break;
 
 			default:
@@ -931,39 +1040,50 @@ void heuristic(double throughput, double power, long time){
 				break;
 		}
 
-		if(!stopped_searching)
-			steps++;
+		if(!ctl->stopped_searching)
+			ctl->steps++;
 
 		#ifdef DEBUG_HEURISTICS
-			printf("Switched to %d threads/cores - pstate %d\n", active_threads, current_pstate);
+			printf("Switched to %d threads/cores - pstate %d\n", ctl->active_threads, ctl->current_pstate);
 		#endif 
 	}
+	else if(uncore_searching){
+		uncore_search(score, power);
+	}
+	else if(config_cache_stale(power)){
+		restart_exploration();
+	}
 	else{	// Workload change detection
-		if(detection_mode == 3){
-			if(heuristic_mode == 15){
+
+		// The online models keep learning from the exploitation rounds, but not from the rounds used to validate them
+		if(ctl->heuristic_mode == 15 && ctl->detection_mode != 3 && !duty_cycle_active())
+			model_add_sample(ctl->current_pstate, ctl->active_threads, throughput, power);
+
+		if(ctl->detection_mode == 3){
+			if(ctl->heuristic_mode == 15){
 				
 				// Copy sample data to compare models with real data
-				power_real[current_pstate][active_threads] = power;
-				throughput_real[current_pstate][active_threads] = throughput;
+				ctl->power_real[ctl->current_pstate][ctl->active_threads] = power;
+				ctl->throughput_real[ctl->current_pstate][ctl->active_threads] = throughput;
 
 				// Copy to the validation array predictions from the model. Necessary as we perform multiple runs of the model
 				// to account for workload variability
-				power_validation[current_pstate][active_threads] = power_model[current_pstate][active_threads];
-				throughput_validation[current_pstate][active_threads] = throughput_model[current_pstate][active_threads];
+				ctl->power_validation[ctl->current_pstate][ctl->active_threads] = ctl->power_model[ctl->current_pstate][ctl->active_threads];
+				ctl->throughput_validation[ctl->current_pstate][ctl->active_threads] = ctl->throughput_model[ctl->current_pstate][ctl->active_threads];
 				
-				if(current_pstate == 1 && active_threads == total_threads){
+				if(ctl->current_pstate == 1 && ctl->active_threads == total_threads){
 
 					// Set validation for p-state equal to lower_sampled_model_pstate
 					for(int l = 1; l<total_threads; l++){
-						power_real[lower_sampled_model_pstate][l] = power_model[lower_sampled_model_pstate][l];
-						throughput_real[lower_sampled_model_pstate][l] = throughput_model[lower_sampled_model_pstate][l];
-						power_validation[lower_sampled_model_pstate][l] = power_model[lower_sampled_model_pstate][l];
-						throughput_validation[lower_sampled_model_pstate][l] = throughput_model[lower_sampled_model_pstate][l];
+						ctl->power_real[lower_sampled_model_pstate][l] = ctl->power_model[lower_sampled_model_pstate][l];
+						ctl->throughput_real[lower_sampled_model_pstate][l] = ctl->throughput_model[lower_sampled_model_pstate][l];
+						ctl->power_validation[lower_sampled_model_pstate][l] = ctl->power_model[lower_sampled_model_pstate][l];
+						ctl->throughput_validation[lower_sampled_model_pstate][l] = ctl->throughput_model[lower_sampled_model_pstate][l];
 					}
 				
 						
 					// Do not restart the exploration/model setup
-					detection_mode = 0;
+					ctl->detection_mode = 0;
 					double t;
 					// Print validation results to file
 
@@ -983,7 +1103,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "Real throughput\n");
 					for(i = 1; i <= max_pstate; i++){
 						for (j = 1; j <= total_threads; j++){
-							fprintf(model_validation_file, "%lf\t", throughput_real[i][j]);
+							fprintf(model_validation_file, "%lf\t", ctl->throughput_real[i][j]);
 						}
 						fprintf(model_validation_file, "\n");
 					}
@@ -992,7 +1112,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "Predicted throughput\n");
 					for(i = 1; i <= max_pstate; i++){
 						for (j = 1; j <= total_threads; j++){
-							fprintf(model_validation_file, "%lf\t", throughput_validation[i][j]);
+							fprintf(model_validation_file, "%lf\t", ctl->throughput_validation[i][j]);
 						}
 						fprintf(model_validation_file, "\n");
 					}
@@ -1001,7 +1121,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "Throughput error percentage\n");
 					for(i = 1; i <= max_pstate; i++){
 						for (j = 1; j <= total_threads; j++){
-							throughput_re=(throughput_validation[i][j]-throughput_real[i][j])/throughput_real[i][j];
+							throughput_re=(ctl->throughput_validation[i][j]-ctl->throughput_real[i][j])/ctl->throughput_real[i][j];
 							fprintf(model_validation_file, "%lf\t", 100*throughput_re);
 							if (i!=lower_sampled_model_pstate && i!=max_pstate) {
 								throughput_abs_re_sum+=fabs(throughput_re);
@@ -1016,7 +1136,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "Real power\n");
 					for(i = 1; i <= max_pstate; i++){
 						for (j = 1; j <= total_threads; j++){
-							fprintf(model_validation_file, "%lf\t", power_real[i][j]);
+							fprintf(model_validation_file, "%lf\t", ctl->power_real[i][j]);
 						}
 						fprintf(model_validation_file, "\n");
 					}
@@ -1025,7 +1145,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "Predicted power\n");
 					for(i = 1; i <= max_pstate; i++){
 						for (j = 1; j <= total_threads; j++){
-							fprintf(model_validation_file, "%lf\t", power_validation[i][j]);
+							fprintf(model_validation_file, "%lf\t", ctl->power_validation[i][j]);
 						}
 						fprintf(model_validation_file, "\n");
 					}
@@ -1034,7 +1154,7 @@ void heuristic(double throughput, double power, long time){
 					fprintf(model_validation_file, "power error percentage\n");
 					for(i = 1; i <= max_pstate; i++){						
 						for (j = 1; j <= total_threads; j++){
-							power_re=(power_validation[i][j]-power_real[i][j])/power_real[i][j];
+							power_re=(ctl->power_validation[i][j]-ctl->power_real[i][j])/ctl->power_real[i][j];
 							fprintf(model_validation_file, "%lf\t", 100*power_re);
 							if (i!=lower_sampled_model_pstate && i!=max_pstate) {
 								power_abs_re_sum+=fabs(power_re);
@@ -1044,6 +1164,8 @@ void heuristic(double throughput, double power, long time){
 						fprintf(model_validation_file, "\n");
 					}
 					fprintf(model_validation_file, "\n");
+
+					fprintf(model_validation_file, "Rounds to decision\n%lf\n", ((double) ctl->model_setup_rounds_sum)/ctl->model_setups);
 					fclose(model_validation_file);
 
 					sprintf(output_filename, "%s-throughput_percent_mre.txt", __progname);
@@ -1063,33 +1185,42 @@ void heuristic(double throughput, double power, long time){
 					printf("\nModel validation completed\n");
 					exit(0);
 				}
-				else if(active_threads == total_threads){ // Should restart the model 
-					validation_pstate--;
-					if(validation_pstate == lower_sampled_model_pstate)
-						validation_pstate--;
-					stopped_searching = 0;
+				else if(ctl->active_threads == total_threads){ // Should restart the model 
+					ctl->validation_pstate--;
+					if(ctl->validation_pstate == lower_sampled_model_pstate)
+						ctl->validation_pstate--;
+					ctl->stopped_searching = 0;
 					set_pstate(max_pstate);
   					set_threads(1);
-  					best_throughput = -1;
-					best_threads = 1;
-					best_pstate = max_pstate;
+  					ctl->best_throughput = -1;
+					ctl->best_threads = 1;
+					ctl->best_pstate = max_pstate;
 
 					#ifdef DEBUG_HEURISTICS
-						printf("Switched to: #threads %d - pstate %d\n", active_threads, current_pstate);
+						printf("Switched to: #threads %d - pstate %d\n", ctl->active_threads, ctl->current_pstate);
 					#endif 
 				}
 				else{ // Not yet finished current P-state, should increase threads
-					set_threads(active_threads+1);
+					set_threads(ctl->active_threads+1);
 
 					#ifdef DEBUG_HEURISTICS
-						printf("Switched to: #threads %d - pstate %d\n", active_threads, current_pstate);
+						printf("Switched to: #threads %d - pstate %d\n", ctl->active_threads, ctl->current_pstate);
 					#endif 
 				}
 			}
 		}
-		else if(detection_mode == 2){
+		else if(ctl->detection_mode == 4){
+			bandit_exploit(score, power);
+		}
+		else if(ctl->detection_mode == 5){
+			if(detect_phase_change(throughput, power))
+				restart_exploration();
+			else if(ctl->heuristic_mode == 10 || ctl->heuristic_mode == 15 || ctl->heuristic_mode == 13 || ctl->heuristic_mode == 16)
+				perform_fluctuation(score, power, time);
+		}
+		else if(ctl->detection_mode == 2){
 
-			if(current_pstate == 0 && heuristic_mode != 10 && power > (power_limit*(1+(1/100))) ){
+			if(ctl->current_pstate == 0 && ctl->heuristic_mode != 10 && !duty_cycle_active() && power > (ctl->power_limit*(1+(1/100))) ){
 				#ifdef DEBUG_HEURISTICS
 					printf("Disabling power boost\n");
 				#endif
@@ -1097,58 +1228,11 @@ void heuristic(double throughput, double power, long time){
 				set_pstate(1);
 			}
 
-			if(current_exploit_steps++ == exploit_steps){
-				
-				#ifdef DEBUG_HEURISTICS
-					printf("EXPLORATION RESTARTED. PHASE 0 - INITIAL CONFIGURATION: #threads %d - p_state %d\n", best_threads, best_pstate);
-				#endif
-				
-				if(heuristic_mode == 11){
-					set_pstate(max_pstate);
-					set_threads(starting_threads);
-				}else if(heuristic_mode == 12 || heuristic_mode == 13 || heuristic_mode == 15){
-					set_pstate(max_pstate);
-					set_threads(1);
-				}else{
-					set_pstate(best_pstate);
-					set_threads(best_threads);
-					starting_threads = best_threads;
-				}
-				
-				best_throughput = -1;
-				best_pstate = -1; 
-				best_threads = -1;
-				best_power = -1;
-
-				high_throughput = -1;
-				high_pstate = -1;
-				high_threads = -1;
-				high_power = -1;
-
-				low_throughput = -1;
-				low_pstate = -1;
-				low_threads = -1;
-				low_power = -1;
-
-				fluctuation_state = 0;
-				window_time = 0;
-				window_power = 0;
-				current_window_slot = 0;
-
-				stopped_searching = 0;
+			if(ctl->current_exploit_steps++ == exploit_steps)
+				restart_exploration();
 
-				min_thread_search = 1;
-				max_thread_search = total_threads;
-
-				min_pstate_search = 0; 
-				max_pstate_search = max_pstate;
-
-				min_thread_search_throughput = -1;
-				max_thread_search_throughput = -1;
-			}
-
-			if((heuristic_mode == 10 || heuristic_mode == 15 || heuristic_mode == 13 || heuristic_mode == 16) && stopped_searching){
-				perform_fluctuation(throughput, power, time);
+			if((ctl->heuristic_mode == 10 || ctl->heuristic_mode == 15 || ctl->heuristic_mode == 13 || ctl->heuristic_mode == 16) && ctl->stopped_searching){
+				perform_fluctuation(score, power, time);
 			}
 		}
 	}
@@ -1159,3 +1243,19 @@ void heuristic(double throughput, double power, long time){
 		printf("DEBUG OVERHEAD -  Inside heuristic(): %lf microseconds\n", time_heuristic_microseconds);
 	#endif 
 }
+
+// Called by the runtime at the end of each round. Applies the changes requested by the node budget and the control socket, then steps main_controller
+void heuristic(double throughput, double power, long time){
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Heuristic called - throughput: %lf - power: %lf Watt - time_interval %lf ms\n", throughput, power, ((double) time)/1000000);
+	#endif
+
+	node_budget_round(throughput);
+
+	// The round was measured with the previous power limit or heuristic
+	if(control_round(throughput, power))
+		return;
+
+	controller_step(throughput, power, time);
+}
@@ -1,2 +1,5 @@
-#define DEBUG_HEURISTICS
-#define PRINT_STATS
+// The replay tool builds without the debug prints, see powercap/Makefile
+#ifndef NO_DEBUG_HEURISTICS
+#define DEBUG_HEURISTICS
+#endif
+#define PRINT_STATS
@@ -0,0 +1,412 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Online power and throughput models
+///////////////////////////////////////////////////////////////
+
+// Same functional forms of the two-point models of heuristic 15, fitted for each number of threads by recursive least squares
+// over all the samples, including the ones taken after the exploration:
+// - power: P(f) - P_uncore = alfa*f^3 + beta*f, with f expressed in GHz and P_uncore learned by uncore.c or set with power_uncore
+// - throughput: 1/T(f) = a + b/f, which is the form T(f) = T(f_max)/(c*f_max/f + m) used by compute_throughput_model()
+// Each sample updates a 2x2 covariance matrix in O(1). With model_forgetting lower than 1 older samples are progressively
+// discounted, so that the models follow workload changes. The confidence of each cell is the standard deviation of its prediction.
+// While an exploitation keeps sampling one configuration the samples carry no information in the other directions, where the
+// forgetting alone would grow the covariance by 1/model_forgetting at each round up to an overflow. The trace of the covariance
+// is therefore bounded by the one of the prior, so that an unexcited direction goes back to the uncertainty of an empty model.
+
+#define MODEL_INITIAL_COVARIANCE 1000000	// Large initial covariance, the first samples dominate the zero prior
+#define MODEL_MAX_COVARIANCE_TRACE (2*MODEL_INITIAL_COVARIANCE)	// Bound of the trace of the covariance, the one of the prior
+
+typedef struct rls_model{
+	double theta[2];		// Fitted coefficients
+	double p[2][2];			// Covariance of the coefficients, up to the variance of the noise
+	double noise;			// Running mean of the squared a-priori residuals, estimates the variance of the noise
+	long samples;			// Number of samples used for the fit
+} rls_model_t;
+
+// State of the models of a controller
+typedef struct model_state{
+	rls_model_t* power_rls;		// One model for each number of threads, index 0 is unused
+	rls_model_t* throughput_rls;
+	int* setup_sampled[2];		// 1 if the thread count was sampled, for max_pstate (0) and lower_sampled_model_pstate (1)
+	double* setup_throughput[2];
+	double* setup_power[2];
+	int setup_completed;		// 1 once the setup is completed, the next sample starts a new setup
+	double usl_coefficients[3];	// Parameters 1/lambda, sigma/lambda and kappa/lambda of the USL fit, N/X(N) is linear in them
+} model_state_t;
+
+static void rls_reset(rls_model_t* model){
+
+	model->theta[0] = 0;
+	model->theta[1] = 0;
+	model->p[0][0] = MODEL_INITIAL_COVARIANCE;
+	model->p[0][1] = 0;
+	model->p[1][0] = 0;
+	model->p[1][1] = MODEL_INITIAL_COVARIANCE;
+	model->noise = 0;
+	model->samples = 0;
+}
+
+// Returns x^T P x, the variance of a prediction at x up to the variance of the noise
+static double rls_leverage(rls_model_t* model, double x0, double x1){
+	return x0*(model->p[0][0]*x0 + model->p[0][1]*x1) + x1*(model->p[1][0]*x0 + model->p[1][1]*x1);
+}
+
+static void rls_update(rls_model_t* model, double x0, double x1, double y){
+
+	double px0 = model->p[0][0]*x0 + model->p[0][1]*x1;
+	double px1 = model->p[1][0]*x0 + model->p[1][1]*x1;
+	double denominator = model_forgetting + x0*px0 + x1*px1;
+	double k0 = px0/denominator;
+	double k1 = px1/denominator;
+	double error = y - (model->theta[0]*x0 + model->theta[1]*x1);
+	double p00, p01, p11, trace;
+
+	// Residuals are meaningful once the coefficients are determined by at least two samples
+	if(model->samples >= 2)
+		model->noise += (error*error - model->noise)/(model->samples - 1);
+
+	model->theta[0] += k0*error;
+	model->theta[1] += k1*error;
+
+	// P = (P - k x^T P) / lambda, the matrix is kept symmetric
+	p00 = (model->p[0][0] - k0*px0)/model_forgetting;
+	p01 = (model->p[0][1] - k0*px1)/model_forgetting;
+	p11 = (model->p[1][1] - k1*px1)/model_forgetting;
+
+	// Scaling keeps the shape of the covariance, only its magnitude is bounded
+	trace = p00 + p11;
+	if(trace > MODEL_MAX_COVARIANCE_TRACE){
+		p00 *= MODEL_MAX_COVARIANCE_TRACE/trace;
+		p01 *= MODEL_MAX_COVARIANCE_TRACE/trace;
+		p11 *= MODEL_MAX_COVARIANCE_TRACE/trace;
+	}
+
+	model->p[0][0] = p00;
+	model->p[0][1] = p01;
+	model->p[1][0] = p01;
+	model->p[1][1] = p11;
+
+	model->samples++;
+}
+
+static double model_frequency(int input_pstate){
+	return ((double) pstate[input_pstate])/1000000;
+}
+
+void init_online_model(){
+
+	int j;
+
+	// Already allocated when a control command switches back to a heuristic that uses the models
+	if(ctl->model != NULL)
+		return;
+
+	ctl->model = calloc(1, sizeof(model_state_t));
+	ctl->model->power_rls = malloc(sizeof(rls_model_t)*(total_threads+1));
+	ctl->model->throughput_rls = malloc(sizeof(rls_model_t)*(total_threads+1));
+
+	for(j = 0; j <= total_threads; j++){
+		rls_reset(&ctl->model->power_rls[j]);
+		rls_reset(&ctl->model->throughput_rls[j]);
+	}
+}
+
+void free_online_model(controller_t* controller){
+
+	int slot;
+
+	if(controller->model == NULL)
+		return;
+
+	for(slot = 0; slot < 2; slot++){
+		free(controller->model->setup_sampled[slot]);
+		free(controller->model->setup_throughput[slot]);
+		free(controller->model->setup_power[slot]);
+	}
+	free(controller->model->power_rls);
+	free(controller->model->throughput_rls);
+	free(controller->model);
+	controller->model = NULL;
+}
+
+static int rls_finite(rls_model_t* model){
+	return isfinite(model->theta[0]) && isfinite(model->theta[1]) && isfinite(model->p[0][0]) && isfinite(model->p[0][1]) && isfinite(model->p[1][1]);
+}
+
+// Returns 1 if the coefficients and covariances of all the models of the controller are finite, or if it has no models
+int online_model_finite(controller_t* controller){
+
+	int j;
+
+	if(controller->model == NULL)
+		return 1;
+
+	for(j = 1; j <= total_threads; j++){
+		if(!rls_finite(&controller->model->power_rls[j]) || !rls_finite(&controller->model->throughput_rls[j]))
+			return 0;
+	}
+
+	return 1;
+}
+
+// Adds the sample of a round to the models of the given number of threads
+void model_add_sample(int input_pstate, int threads, double throughput, double power){
+
+	double f = model_frequency(input_pstate);
+
+	if(ctl->model == NULL || threads < 1 || threads > total_threads || throughput <= 0 || power <= 0)
+		return;
+
+	rls_update(&ctl->model->power_rls[threads], f*f*f, f, power - get_uncore_power(current_uncore_pstate));
+	rls_update(&ctl->model->throughput_rls[threads], 1, 1/f, 1/throughput);
+}
+
+// Returns the predicted power, expressed in Watt
+double model_power(int input_pstate, int threads){
+
+	double f = model_frequency(input_pstate);
+	rls_model_t* model = &ctl->model->power_rls[threads];
+
+	return model->theta[0]*f*f*f + model->theta[1]*f + get_uncore_power(current_uncore_pstate);
+}
+
+// Returns the predicted throughput. Returns 0 if the model cannot predict a positive throughput yet
+double model_throughput(int input_pstate, int threads){
+
+	double f = model_frequency(input_pstate);
+	rls_model_t* model = &ctl->model->throughput_rls[threads];
+	double inverse_throughput = model->theta[0] + model->theta[1]/f;
+
+	if(inverse_throughput <= 0)
+		return 0;
+	return 1/inverse_throughput;
+}
+
+// Standard deviation of the predicted power, expressed in Watt
+double model_power_stddev(int input_pstate, int threads){
+
+	double f = model_frequency(input_pstate);
+	rls_model_t* model = &ctl->model->power_rls[threads];
+
+	return sqrt(model->noise*rls_leverage(model, f*f*f, f));
+}
+
+// Standard deviation of the predicted throughput, propagated from the one of 1/T
+double model_throughput_stddev(int input_pstate, int threads){
+
+	double f = model_frequency(input_pstate);
+	rls_model_t* model = &ctl->model->throughput_rls[threads];
+	double throughput = model_throughput(input_pstate, threads);
+
+	return throughput*throughput*sqrt(model->noise*rls_leverage(model, 1, 1/f));
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// Reduced sampling of the thread counts
+///////////////////////////////////////////////////////////////
+
+// With model_sampled_threads higher than 0, the setup of heuristic 15 samples only a subset of the thread counts at each of the two
+// sampled p-states. The subset starts with 1 and total_threads, then each further thread count is the midpoint of the gap where a
+// Universal Scalability Law fit of the samples deviates most from the linear interpolation of the samples at the ends of the gap.
+// The subset chosen at max_pstate is sampled again at lower_sampled_model_pstate. At the end of each p-state the unsampled thread counts
+// are filled with the USL fit for throughput, X(N) = lambda*N/(1 + sigma*(N-1) + kappa*N*(N-1)), and a linear fit for power,
+// and added as samples to the online models.
+
+static void model_setup_reset(){
+
+	int slot, j;
+
+	for(slot = 0; slot < 2; slot++){
+		if(ctl->model->setup_sampled[slot] == NULL){
+			ctl->model->setup_sampled[slot] = malloc(sizeof(int)*(total_threads+1));
+			ctl->model->setup_throughput[slot] = malloc(sizeof(double)*(total_threads+1));
+			ctl->model->setup_power[slot] = malloc(sizeof(double)*(total_threads+1));
+		}
+		for(j = 0; j <= total_threads; j++)
+			ctl->model->setup_sampled[slot][j] = 0;
+	}
+
+	ctl->model_setup_rounds = 0;
+	ctl->model->setup_completed = 0;
+}
+
+static double determinant3(double m[3][3]){
+	return m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1]) - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0]) + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+}
+
+// Least squares fit of N/X(N) = c0 + c1*(N-1) + c2*N*(N-1) over the sampled thread counts, solved with Cramer's rule.
+// Returns 0 if there are less than 3 samples or the fit is degenerate
+static int fit_usl(int slot){
+
+	double a[3][3] = {{0}}, b[3] = {0}, m[3][3], x[3], det;
+	int i, k, j, samples = 0;
+
+	for(j = 1; j <= total_threads; j++){
+		if(!ctl->model->setup_sampled[slot][j] || ctl->model->setup_throughput[slot][j] <= 0)
+			continue;
+		x[0] = 1;
+		x[1] = j-1;
+		x[2] = ((double) j)*(j-1);
+		for(i = 0; i < 3; i++){
+			for(k = 0; k < 3; k++)
+				a[i][k] += x[i]*x[k];
+			b[i] += x[i]*j/ctl->model->setup_throughput[slot][j];
+		}
+		samples++;
+	}
+
+	if(samples < 3)
+		return 0;
+
+	det = determinant3(a);
+	if(fabs(det) < 1e-12)
+		return 0;
+
+	for(k = 0; k < 3; k++){
+		for(i = 0; i < 3; i++)
+			for(j = 0; j < 3; j++)
+				m[i][j] = j == k ? b[i] : a[i][j];
+		ctl->model->usl_coefficients[k] = determinant3(m)/det;
+	}
+
+	return ctl->model->usl_coefficients[0] > 0;
+}
+
+// Throughput of the USL fit, 0 if not meaningful
+static double usl_throughput(int threads){
+
+	double denominator = ctl->model->usl_coefficients[0] + ctl->model->usl_coefficients[1]*(threads-1) + ctl->model->usl_coefficients[2]*((double) threads)*(threads-1);
+
+	if(denominator <= 0)
+		return 0;
+	return threads/denominator;
+}
+
+// Linear interpolation of the sampled values at the closest sampled thread counts below and above threads
+static double interpolate_samples(int slot, double* values, int threads){
+
+	int low = threads, high = threads;
+
+	while(low > 1 && !ctl->model->setup_sampled[slot][low])
+		low--;
+	while(high < total_threads && !ctl->model->setup_sampled[slot][high])
+		high++;
+
+	if(high == low)
+		return values[low];
+	return values[low] + (values[high]-values[low])*(threads-low)/(high-low);
+}
+
+// Stores the sample of a setup round
+void model_record_setup_sample(int slot, int threads, double throughput, double power){
+
+	if(ctl->model->setup_sampled[0] == NULL || ctl->model->setup_completed)
+		model_setup_reset();
+
+	ctl->model->setup_sampled[slot][threads] = 1;
+	ctl->model->setup_throughput[slot][threads] = throughput;
+	ctl->model->setup_power[slot][threads] = power;
+	ctl->model_setup_rounds++;
+}
+
+// Returns the next thread count to sample at the given slot, 0 if all the thread counts of the subset were sampled
+int model_next_threads(int slot){
+
+	int j, low, sampled = 0, usl_valid, best = 0;
+	double score, best_score = -1, interpolated;
+
+	// At lower_sampled_model_pstate the thread counts sampled at max_pstate are sampled in increasing order
+	if(slot == 1){
+		for(j = 1; j <= total_threads; j++){
+			if(ctl->model->setup_sampled[0][j] && !ctl->model->setup_sampled[1][j])
+				return j;
+		}
+		return 0;
+	}
+
+	// Without reduced sampling all the thread counts are sampled in increasing order
+	if(model_sampled_threads <= 0 || model_sampled_threads >= total_threads){
+		for(j = 1; j <= total_threads; j++){
+			if(!ctl->model->setup_sampled[0][j])
+				return j;
+		}
+		return 0;
+	}
+
+	for(j = 1; j <= total_threads; j++)
+		sampled += ctl->model->setup_sampled[0][j];
+
+	if(!ctl->model->setup_sampled[0][1])
+		return 1;
+	if(!ctl->model->setup_sampled[0][total_threads])
+		return total_threads;
+	if(sampled >= model_sampled_threads)
+		return 0;
+
+	usl_valid = fit_usl(0);
+
+	// Midpoint of the gap where the USL fit deviates most from the interpolation, weighted by the width of the gap
+	low = 1;
+	for(j = 2; j <= total_threads; j++){
+		if(!ctl->model->setup_sampled[0][j])
+			continue;
+		if(j - low > 1){
+			score = j - low;
+			if(usl_valid){
+				interpolated = interpolate_samples(0, ctl->model->setup_throughput[0], (low+j)/2);
+				score *= fabs(usl_throughput((low+j)/2) - interpolated)/interpolated;
+			}
+			if(score > best_score){
+				best_score = score;
+				best = (low+j)/2;
+			}
+		}
+		low = j;
+	}
+
+	return best;
+}
+
+// Fills the thread counts not sampled at the given slot with the USL fit of throughput and the linear fit of power,
+// and adds them as samples to the online models
+void model_interpolate_threads(int input_pstate, int slot){
+
+	double sum_n = 0, sum_p = 0, sum_nn = 0, sum_np = 0, slope = 0, intercept, throughput;
+	int j, samples = 0, usl_valid = fit_usl(slot);
+
+	for(j = 1; j <= total_threads; j++){
+		if(ctl->model->setup_sampled[slot][j]){
+			sum_n += j;
+			sum_p += ctl->model->setup_power[slot][j];
+			sum_nn += ((double) j)*j;
+			sum_np += j*ctl->model->setup_power[slot][j];
+			samples++;
+		}
+	}
+
+	if(samples > 1)
+		slope = (samples*sum_np - sum_n*sum_p)/(samples*sum_nn - sum_n*sum_n);
+	intercept = (sum_p - slope*sum_n)/samples;
+
+	#ifdef DEBUG_HEURISTICS
+		printf("Thread interpolation at p-state %d - %d sampled thread counts - USL %s - lambda %lf - sigma %lf - kappa %lf\n", input_pstate, samples,
+			usl_valid ? "valid" : "not valid", 1/ctl->model->usl_coefficients[0], ctl->model->usl_coefficients[1]/ctl->model->usl_coefficients[0], ctl->model->usl_coefficients[2]/ctl->model->usl_coefficients[0]);
+	#endif
+
+	for(j = 1; j <= total_threads; j++){
+		if(ctl->model->setup_sampled[slot][j])
+			continue;
+		throughput = usl_valid ? usl_throughput(j) : 0;
+		if(throughput <= 0)
+			throughput = interpolate_samples(slot, ctl->model->setup_throughput[slot], j);
+		model_add_sample(input_pstate, j, throughput, intercept + slope*j);
+	}
+
+	if(slot == 1)
+		ctl->model->setup_completed = 1;
+}
@@ -0,0 +1,195 @@
+#include "powercap.h"
+#include <stdlib.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Model predictive power controller
+///////////////////////////////////////////////////////////////
+
+// Heuristic 18 never stops searching: at every round it picks the configuration to run next from the online models of model.c,
+// as a one-step model predictive controller that tracks power_limit. The power predicted by the models is corrected by a bias,
+// the integral of the error between the measured power and the prediction, which removes the steady state error of the models.
+// Among the configurations within MPC_PSTATE_MOVE p-states and MPC_THREADS_MOVE threads from the current one, it runs the one
+// with the highest predicted score of the objective whose predicted power plus MPC_CONFIDENCE standard deviations is within power_limit,
+// or the one with the lowest predicted power if none is. Bounding the moves bounds the overshoot after a wrong prediction.
+// Thread counts whose models are not fitted yet are predicted by scaling the models of the current one, and their first
+// rounds alternate two p-states to fit them. The integral gain is tuned from the response of the plant: it is reduced when
+// the error of the predicted power oscillates and increased when it keeps the same sign for MPC_SLOW_ROUNDS rounds.
+
+#define MPC_PSTATE_MOVE 1			// Maximum change of p-state in a round
+#define MPC_THREADS_MOVE 2			// Maximum change of threads in a round
+#define MPC_CONFIDENCE 1			// Standard deviations of the predicted power kept below power_limit
+#define MPC_MIN_IMPROVEMENT 0.01	// Relative improvement of the score required to leave a configuration within power_limit
+#define MPC_INITIAL_GAIN 0.5
+#define MPC_MIN_GAIN 0.05
+#define MPC_SLOW_ROUNDS 3			// Rounds with error of the same sign before the gain is increased
+#define MPC_DEADBAND 0.01			// Errors within this fraction of power_limit do not tune the gain
+
+// State of heuristic 18 of a controller
+typedef struct mpc_state{
+	int* first_pstate;			// P-state of the first sample for each number of threads, -1 if none
+	int* fitted;				// 1 once the models of a number of threads have samples at two p-states
+	double bias;				// Integral of the error of the predicted power, expressed in Watt
+	double gain;
+	int error_sign;				// Sign of the prediction error of the last round
+	int same_sign_rounds;
+} mpc_state_t;
+
+void init_mpc(){
+
+	mpc_state_t* mpc;
+	int i;
+
+	if(ctl->mpc != NULL)
+		return;
+
+	mpc = ctl->mpc = calloc(1, sizeof(mpc_state_t));
+	mpc->gain = MPC_INITIAL_GAIN;
+	mpc->first_pstate = malloc(sizeof(int)*(total_threads+1));
+	mpc->fitted = malloc(sizeof(int)*(total_threads+1));
+	for(i = 0; i <= total_threads; i++){
+		mpc->first_pstate[i] = -1;
+		mpc->fitted[i] = 0;
+	}
+}
+
+// Predicts power and throughput of a configuration. Returns 0 if neither its models nor the ones of the current threads are fitted
+static int mpc_predict(int threads, int input_pstate, double* power, double* power_stddev, double* throughput){
+
+	mpc_state_t* mpc = ctl->mpc;
+	double scale, uncore = get_uncore_power(current_uncore_pstate);
+
+	if(mpc->fitted[threads]){
+		*power = model_power(input_pstate, threads);
+		*power_stddev = model_power_stddev(input_pstate, threads);
+		*throughput = model_throughput(input_pstate, threads);
+	}else if(mpc->fitted[ctl->active_threads]){
+		// Core power and throughput assumed linear with the number of threads
+		scale = ((double) threads)/ctl->active_threads;
+		*power = uncore + (model_power(input_pstate, ctl->active_threads) - uncore)*scale;
+		*power_stddev = model_power_stddev(input_pstate, ctl->active_threads)*scale;
+		*throughput = model_throughput(input_pstate, ctl->active_threads)*scale;
+	}else
+		return 0;
+
+	*power += mpc->bias;
+	return *throughput > 0;
+}
+
+// Tunes the gain from the error of the power predicted for the round, bias included
+static void mpc_tune_gain(double error){
+
+	mpc_state_t* mpc = ctl->mpc;
+	int sign = 0;
+
+	if(error > ctl->power_limit*MPC_DEADBAND)
+		sign = 1;
+	else if(error < -ctl->power_limit*MPC_DEADBAND)
+		sign = -1;
+
+	if(sign != 0 && sign == -mpc->error_sign){
+		// Oscillation of the bias
+		mpc->gain *= 0.7;
+		if(mpc->gain < MPC_MIN_GAIN)
+			mpc->gain = MPC_MIN_GAIN;
+		mpc->same_sign_rounds = 0;
+	}else if(sign != 0 && ++mpc->same_sign_rounds >= MPC_SLOW_ROUNDS){
+		// Slow convergence
+		mpc->gain *= 1.3;
+		if(mpc->gain > 1)
+			mpc->gain = 1;
+		mpc->same_sign_rounds = 0;
+	}
+
+	if(sign == 0)
+		mpc->same_sign_rounds = 0;
+	mpc->error_sign = sign;
+}
+
+void heuristic_mpc(double throughput, double power){
+
+	mpc_state_t* mpc = ctl->mpc;
+	double predicted_power, predicted_stddev, predicted_throughput, predicted_score, current_score = -1, best_predicted = -1, lowest_power = -1, error;
+	int i, j, next_threads = ctl->active_threads, next_pstate = ctl->current_pstate, lowest_threads = ctl->active_threads, lowest_pstate = ctl->current_pstate;
+
+	// Bias update with the prediction made before the sample is added to the models
+	if(mpc->fitted[ctl->active_threads]){
+		error = power - model_power(ctl->current_pstate, ctl->active_threads) - mpc->bias;
+		mpc_tune_gain(error);
+		mpc->bias += mpc->gain*error;
+	}
+
+	model_add_sample(ctl->current_pstate, ctl->active_threads, throughput, power);
+	if(mpc->first_pstate[ctl->active_threads] == -1)
+		mpc->first_pstate[ctl->active_threads] = ctl->current_pstate;
+	else if(mpc->first_pstate[ctl->active_threads] != ctl->current_pstate)
+		mpc->fitted[ctl->active_threads] = 1;
+
+	ctl->best_threads = ctl->active_threads;
+	ctl->best_pstate = ctl->current_pstate;
+	ctl->best_throughput = objective_score(throughput, power);
+	ctl->best_power = power;
+
+	// The models of the current threads need a sample at a second p-state
+	if(!mpc->fitted[ctl->active_threads]){
+		if(power > ctl->power_limit && ctl->current_pstate == max_pstate && ctl->active_threads > 1)
+			set_threads(ctl->active_threads-1);
+		else if((power < ctl->power_limit || ctl->current_pstate == max_pstate) && ctl->current_pstate > 0)
+			set_pstate(ctl->current_pstate-1);
+		else if(ctl->current_pstate < max_pstate)
+			set_pstate(ctl->current_pstate+1);
+		return;
+	}
+
+	for(i = ctl->current_pstate-MPC_PSTATE_MOVE; i <= ctl->current_pstate+MPC_PSTATE_MOVE; i++){
+		for(j = ctl->active_threads-MPC_THREADS_MOVE; j <= ctl->active_threads+MPC_THREADS_MOVE; j++){
+			if(i < 0 || i > max_pstate || j < 1 || j > total_threads)
+				continue;
+			if(!mpc_predict(j, i, &predicted_power, &predicted_stddev, &predicted_throughput))
+				continue;
+			predicted_score = objective_score(predicted_throughput, predicted_power);
+
+			if(i == ctl->current_pstate && j == ctl->active_threads && predicted_power + MPC_CONFIDENCE*predicted_stddev <= ctl->power_limit)
+				current_score = predicted_score;
+
+			if(predicted_power + MPC_CONFIDENCE*predicted_stddev <= ctl->power_limit && predicted_score > best_predicted){
+				best_predicted = predicted_score;
+				next_threads = j;
+				next_pstate = i;
+			}
+			if(lowest_power < 0 || predicted_power < lowest_power){
+				lowest_power = predicted_power;
+				lowest_threads = j;
+				lowest_pstate = i;
+			}
+		}
+	}
+
+	if(best_predicted < 0){
+		next_threads = lowest_threads;
+		next_pstate = lowest_pstate;
+	}else if(current_score > 0 && best_predicted < current_score*(1+MPC_MIN_IMPROVEMENT)){
+		next_threads = ctl->active_threads;
+		next_pstate = ctl->current_pstate;
+	}
+
+	#ifdef DEBUG_HEURISTICS
+		printf("MPC - power %lf - bias %lf - gain %lf - next %d threads p-state %d - predicted score %lf\n", power, mpc->bias, mpc->gain,
+			next_threads, next_pstate, best_predicted);
+	#endif
+
+	set_pstate(next_pstate);
+	set_threads(next_threads);
+}
+
+void free_mpc(controller_t* controller){
+
+	if(controller->mpc == NULL)
+		return;
+
+	free(controller->mpc->first_pstate);
+	free(controller->mpc->fitted);
+	free(controller->mpc);
+	controller->mpc = NULL;
+}
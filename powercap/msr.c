@@ -0,0 +1,248 @@
+#include "powercap.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// MSR backend
+///////////////////////////////////////////////////////////////
+
+// Alternative to the sysfs paths of dvfs.c and energy.c for sub-millisecond rounds. Energy is read from the RAPL status registers
+// and the frequency is requested writing IA32_PERF_CTL, both through the msr driver (/dev/cpu/N/msr) with pread/pwrite at the
+// offset of the register. Any regular file can be used as device, which allows running the backend on a fake MSR tree.
+
+#define MSR_RAPL_POWER_UNIT			0x606
+#define MSR_PKG_ENERGY_STATUS		0x611
+#define MSR_DRAM_ENERGY_STATUS		0x619
+#define MSR_PP0_ENERGY_STATUS		0x639
+#define IA32_PERF_CTL				0x199
+
+// The DRAM domain of Intel server processors counts in a fixed unit of 2^-16 Joule instead of the unit reported by
+// MSR_RAPL_POWER_UNIT. Models as listed by the intel_rapl driver: Haswell-X, Broadwell-X and -D, Skylake-X, Xeon Phi,
+// Ice Lake-X and -D, Sapphire Rapids, Emerald Rapids and Granite Rapids
+#define DRAM_FIXED_UNIT_UJ			15.2587890625
+static int dram_fixed_unit_models[] = {0x3f, 0x4f, 0x56, 0x55, 0x57, 0x85, 0x6a, 0x6c, 0x8f, 0xcf, 0xad, 0xae};
+
+typedef struct msr_energy_domain{
+	int msr;				// Address of the energy status register, 0 if the domain is not available
+	double unit;			// Energy unit of the register, expressed in micro Joule
+	uint32_t last_raw;		// Last value read from the register
+	long units;				// Energy units consumed since init_msr_management(), corrected for wraparounds
+} msr_energy_domain_t;
+
+static int* msr_fd;							// One descriptor for each core
+static int* package_cpu;					// First core of each package, used to read package-wide registers
+static double* energy_unit;					// Energy unit of each package, expressed in micro Joule
+static msr_energy_domain_t* msr_package_domains;
+static msr_energy_domain_t* msr_core_domains;
+static msr_energy_domain_t* msr_dram_domains;
+static pthread_mutex_t msr_lock = PTHREAD_MUTEX_INITIALIZER;	// get_energy() might run on the application, controller and duty cycling threads
+
+static uint64_t read_msr(int cpu, int msr){
+
+	uint64_t value;
+
+	if(pread(msr_fd[cpu], &value, sizeof(uint64_t), msr) != sizeof(uint64_t)){
+		printf("Error reading msr 0x%x of cpu %d\n", msr, cpu);
+		exit(1);
+	}
+	return value;
+}
+
+// Returns 1 and the value of the register if it can be read. The energy status registers of the core and DRAM domains
+// are not implemented by all processors, and reading them fails with EIO
+static int probe_msr(int cpu, int msr, uint64_t* value){
+	return pread(msr_fd[cpu], value, sizeof(uint64_t), msr) == sizeof(uint64_t);
+}
+
+static void write_msr(int cpu, int msr, uint64_t value){
+
+	if(pwrite(msr_fd[cpu], &value, sizeof(uint64_t), msr) != sizeof(uint64_t)){
+		printf("Error writing msr 0x%x of cpu %d\n", msr, cpu);
+		exit(1);
+	}
+}
+
+// Converts the energy status unit field (bits 12:8) of MSR_RAPL_POWER_UNIT to micro Joule
+double rapl_energy_unit_uj(uint64_t power_unit){
+	return 1000000.0 / ((double) (1L << ((power_unit >> 8) & 0x1f)));
+}
+
+// Returns the energy of the domain in micro Joule, 0 if the domain is not available
+static long read_msr_energy_domain(int package, msr_energy_domain_t* domain){
+
+	uint32_t raw;
+	long energy;
+
+	if(domain->msr == 0)
+		return 0;
+
+	pthread_mutex_lock(&msr_lock);
+
+	raw = (uint32_t) read_msr(package_cpu[package], domain->msr);
+
+	// Unsigned arithmetic on 32 bits already accounts for a single wraparound of the register
+	if(raw < domain->last_raw)
+		energy_wraparounds++;
+	domain->units += (uint32_t) (raw - domain->last_raw);
+	domain->last_raw = raw;
+	energy = (long) (((double) domain->units) * domain->unit);
+
+	pthread_mutex_unlock(&msr_lock);
+
+	return energy;
+}
+
+// Sets the domain up if its register can be read, otherwise marks it as not available
+static void init_msr_energy_domain(int package, msr_energy_domain_t* domain, int msr, double unit){
+
+	uint64_t value;
+
+	domain->msr = probe_msr(package_cpu[package], msr, &value) ? msr : 0;
+	domain->unit = unit;
+	domain->last_raw = (uint32_t) value;
+	domain->units = 0;
+}
+
+// Returns 1 if the processor is an Intel server model whose DRAM domain uses DRAM_FIXED_UNIT_UJ
+static int dram_has_fixed_unit(){
+
+	FILE* cpuinfo;
+	char line[256], vendor[32] = "";
+	int family = -1, model = -1;
+	unsigned int i;
+
+	// A fake MSR tree is not related to the processor running the backend
+	if(strcmp(msr_root, "/dev") != 0)
+		return 0;
+
+	if((cpuinfo = fopen("/proc/cpuinfo", "r")) == NULL)
+		return 0;
+	while(fgets(line, sizeof(line), cpuinfo) != NULL && model < 0){
+		if(sscanf(line, "vendor_id : %31s", vendor) == 1 || sscanf(line, "cpu family : %d", &family) == 1)
+			continue;
+		sscanf(line, "model : %d", &model);
+	}
+	fclose(cpuinfo);
+
+	if(strcmp(vendor, "GenuineIntel") != 0 || family != 6)
+		return 0;
+	for(i = 0; i < sizeof(dram_fixed_unit_models)/sizeof(int); i++){
+		if(model == dram_fixed_unit_models[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+// Opens the msr device of all cores and reads the energy unit of each package. Must be called after discover_packages()
+void init_msr_management(){
+
+	char fname[512];
+	int i, dram_fixed_unit;
+
+	msr_fd = malloc(sizeof(int)*nb_cores);
+	for(i = 0; i < nb_cores; i++){
+		sprintf(fname, "%s/cpu/%d/msr", msr_root, i);
+		msr_fd[i] = open(fname, O_RDWR);
+		if(msr_fd[i] < 0){
+			printf("Error opening %s. The msr module must be loaded and the application must run as superuser\n", fname);
+			exit(1);
+		}
+	}
+
+	package_cpu = malloc(sizeof(int)*nb_packages);
+	for(i = 0; i < nb_packages; i++)
+		package_cpu[i] = -1;
+
+	for(i = 0; i < nb_cores; i++){
+		if(package_cpu[core_package[i]] == -1)
+			package_cpu[core_package[i]] = i;
+	}
+
+	energy_unit = malloc(sizeof(double)*nb_packages);
+	msr_package_domains = malloc(sizeof(msr_energy_domain_t)*nb_packages);
+	msr_core_domains = malloc(sizeof(msr_energy_domain_t)*nb_packages);
+	msr_dram_domains = malloc(sizeof(msr_energy_domain_t)*nb_packages);
+	energy_wraparounds = 0;
+	dram_fixed_unit = dram_has_fixed_unit();
+
+	for(i = 0; i < nb_packages; i++){
+		if(package_cpu[i] == -1){
+			printf("No cpu found for package %d\n", i);
+			exit(1);
+		}
+
+		energy_unit[i] = rapl_energy_unit_uj(read_msr(package_cpu[i], MSR_RAPL_POWER_UNIT));
+
+		// The package domain is always present, core (PP0) and DRAM domains are optional as the sysfs subdomains of energy.c
+		msr_package_domains[i].msr = MSR_PKG_ENERGY_STATUS;
+		msr_package_domains[i].unit = energy_unit[i];
+		msr_package_domains[i].last_raw = (uint32_t) read_msr(package_cpu[i], MSR_PKG_ENERGY_STATUS);
+		msr_package_domains[i].units = 0;
+
+		init_msr_energy_domain(i, &msr_core_domains[i], MSR_PP0_ENERGY_STATUS, energy_unit[i]);
+		init_msr_energy_domain(i, &msr_dram_domains[i], MSR_DRAM_ENERGY_STATUS, dram_fixed_unit ? DRAM_FIXED_UNIT_UJ : energy_unit[i]);
+
+		#ifdef DEBUG_HEURISTICS
+		printf("Package %d read through msr of cpu %d - energy unit %lf uJ - core domain %s - dram domain %s (unit %lf uJ)\n", i, package_cpu[i], energy_unit[i],
+			msr_core_domains[i].msr == 0 ? "not available" : "available", msr_dram_domains[i].msr == 0 ? "not available" : "available", msr_dram_domains[i].unit);
+		#endif
+	}
+
+	current_pstate = -1;
+	set_pstate(max_pstate);
+}
+
+// Returns energy consumption of all packages in micro Joule
+long msr_get_energy(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i < nb_packages; i++)
+		total_energy += read_msr_energy_domain(i, &msr_package_domains[i]);
+
+	return total_energy;
+}
+
+// Returns energy consumption of the cores of all packages in micro Joule, 0 if not available
+long msr_get_energy_core(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i < nb_packages; i++)
+		total_energy += read_msr_energy_domain(i, &msr_core_domains[i]);
+
+	return total_energy;
+}
+
+// Returns energy consumption of the DRAM of all packages in micro Joule, 0 if not available
+long msr_get_energy_dram(){
+
+	long total_energy = 0;
+	int i;
+
+	for(i = 0; i < nb_packages; i++)
+		total_energy += read_msr_energy_domain(i, &msr_dram_domains[i]);
+
+	return total_energy;
+}
+
+// Requests the frequency, expressed in KHz, to all cores. The target ratio is in bits 15:8 of IA32_PERF_CTL, in units of the 100MHz bus clock
+void msr_set_frequency(int frequency){
+
+	uint64_t perf_ctl = ((uint64_t) (frequency/100000) & 0xff) << 8;
+	int i;
+
+	for(i = 0; i < nb_cores; i++)
+		write_msr(i, IA32_PERF_CTL, perf_ctl);
+}
+
+// Requests the frequency, expressed in KHz, to a single core
+void msr_set_core_frequency(int core, int frequency){
+	write_msr(core, IA32_PERF_CTL, ((uint64_t) (frequency/100000) & 0xff) << 8);
+}
@@ -0,0 +1,251 @@
+#include "powercap.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Node power budget
+///////////////////////////////////////////////////////////////
+
+// With node_budget higher than 0, the processes running on the node share node_budget Watt instead of using power_limit each.
+// They map the same file node_file, which holds the power limit of each process, and lock it with flock() to update it, so that
+// the locks of a process that crashed are released by the kernel. A process that joins gets an equal share of the budget, taken
+// proportionally from the others, and the limit of a process that terminates is split among the remaining ones.
+// There is no arbiter process: at each round a process publishes the throughput gain of a higher limit and the loss of a lower one,
+// taken from its Pareto frontier and relative to its current throughput, since the throughput of different applications is not comparable.
+// Every node_period milliseconds the first process that runs a round moves NODE_STEP_FRACTION of an equal share from the process with
+// the lowest loss to the one with the highest gain, if the gain is higher. Each process applies its new limit as powercap_set_power_limit().
+
+#define NODE_MAX_JOBS 64
+#define NODE_STEP_FRACTION 0.05		// Watt moved at each arbitration, as a fraction of an equal share of the budget
+#define NODE_MIN_FRACTION 0.25		// Minimum limit of a process, as a fraction of an equal share of the budget
+#define NODE_HYSTERESIS 0.1			// Relative margin of the gain over the loss required to move the watts
+
+typedef struct node_job{
+	int pid;					// 0 if the slot is free
+	int ready;					// 1 when the process runs at a configuration chosen for its limit
+	double limit;
+	double gain;				// Relative throughput gained and lost per Watt by moving the limit by one step
+	double loss;
+} node_job_t;
+
+typedef struct node_segment{
+	double budget;
+	long last_arbitration;
+	node_job_t jobs[NODE_MAX_JOBS];
+} node_segment_t;
+
+static int node_fd = -1;
+static node_segment_t* node_segment;
+static int node_slot = -1;
+
+static void node_lock(){
+	flock(node_fd, LOCK_EX);
+}
+
+static void node_unlock(){
+	flock(node_fd, LOCK_UN);
+}
+
+static int node_live_jobs(){
+
+	int i, count = 0;
+
+	for(i = 0; i < NODE_MAX_JOBS; i++)
+		count += node_segment->jobs[i].pid != 0;
+
+	return count;
+}
+
+// Frees a slot and splits its limit among the remaining processes
+static void node_release(int slot){
+
+	double limit = node_segment->jobs[slot].limit;
+	int i, count;
+
+	node_segment->jobs[slot].pid = 0;
+	node_segment->jobs[slot].limit = 0;
+
+	count = node_live_jobs();
+	for(i = 0; i < NODE_MAX_JOBS && count > 0; i++){
+		if(node_segment->jobs[i].pid != 0)
+			node_segment->jobs[i].limit += limit/count;
+	}
+}
+
+// Releases the slots of the processes that terminated without leaving
+static void node_reclaim(){
+
+	int i;
+
+	for(i = 0; i < NODE_MAX_JOBS; i++){
+		if(node_segment->jobs[i].pid != 0 && kill(node_segment->jobs[i].pid, 0) != 0 && errno == ESRCH){
+			#ifdef DEBUG_HEURISTICS
+				printf("NODE BUDGET - process %d terminated, releasing %lf Watt\n", node_segment->jobs[i].pid, node_segment->jobs[i].limit);
+			#endif
+			node_release(i);
+		}
+	}
+}
+
+static void node_arbitrate(){
+
+	double share = node_segment->budget/node_live_jobs(), step = share*NODE_STEP_FRACTION;
+	int i, receiver = -1, donor = -1;
+
+	for(i = 0; i < NODE_MAX_JOBS; i++){
+		if(node_segment->jobs[i].pid == 0 || !node_segment->jobs[i].ready)
+			continue;
+		if(receiver == -1 || node_segment->jobs[i].gain > node_segment->jobs[receiver].gain)
+			receiver = i;
+	}
+
+	for(i = 0; i < NODE_MAX_JOBS; i++){
+		if(i == receiver || node_segment->jobs[i].pid == 0 || !node_segment->jobs[i].ready || node_segment->jobs[i].limit - step < share*NODE_MIN_FRACTION)
+			continue;
+		if(donor == -1 || node_segment->jobs[i].loss < node_segment->jobs[donor].loss)
+			donor = i;
+	}
+
+	if(receiver == -1 || donor == -1 || node_segment->jobs[receiver].gain <= node_segment->jobs[donor].loss*(1+NODE_HYSTERESIS))
+		return;
+
+	node_segment->jobs[receiver].limit += step;
+	node_segment->jobs[donor].limit -= step;
+
+	// Both processes must apply their new limit before they are compared again
+	node_segment->jobs[receiver].ready = 0;
+	node_segment->jobs[donor].ready = 0;
+
+	#ifdef DEBUG_HEURISTICS
+		printf("NODE BUDGET - %lf Watt moved from process %d (loss %lf) to process %d (gain %lf)\n", step, node_segment->jobs[donor].pid,
+			node_segment->jobs[donor].loss, node_segment->jobs[receiver].pid, node_segment->jobs[receiver].gain);
+	#endif
+}
+
+// Throughput of the frontier point within the limit, 0 if none
+static double node_frontier_throughput(double limit){
+
+	int point = pareto_best_within(limit), threads, input_pstate;
+	double throughput, power;
+
+	if(point < 0 || !pareto_frontier_point(point, &threads, &input_pstate, &throughput, &power))
+		return 0;
+
+	return throughput;
+}
+
+void init_node_budget(){
+
+	int i, count;
+	struct stat info;
+
+	if(node_budget <= 0)
+		return;
+
+	if((node_fd = open(node_file, O_RDWR | O_CREAT, 0666)) < 0){
+		printf("Error opening the node budget file %s\n", node_file);
+		exit(1);
+	}
+
+	node_lock();
+	if(fstat(node_fd, &info) != 0 || (info.st_size < (off_t) sizeof(node_segment_t) && ftruncate(node_fd, sizeof(node_segment_t)) != 0)){
+		printf("Error resizing the node budget file %s\n", node_file);
+		exit(1);
+	}
+
+	node_segment = mmap(NULL, sizeof(node_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, node_fd, 0);
+	if(node_segment == MAP_FAILED){
+		printf("Error mapping the node budget file %s\n", node_file);
+		exit(1);
+	}
+
+	node_reclaim();
+	count = node_live_jobs();
+
+	// The first process sets the budget, the others use it
+	if(count == 0){
+		node_segment->budget = node_budget;
+		node_segment->last_arbitration = 0;
+	}
+
+	for(i = 0; i < NODE_MAX_JOBS && node_slot == -1; i++){
+		if(node_segment->jobs[i].pid == 0)
+			node_slot = i;
+	}
+	if(node_slot == -1){
+		printf("More than %d processes share the node budget\n", NODE_MAX_JOBS);
+		exit(1);
+	}
+
+	// The new process takes an equal share, proportionally from the others
+	for(i = 0; i < NODE_MAX_JOBS; i++){
+		if(node_segment->jobs[i].pid != 0)
+			node_segment->jobs[i].limit *= ((double) count)/(count+1);
+	}
+	node_segment->jobs[node_slot].pid = getpid();
+	node_segment->jobs[node_slot].ready = 0;
+	node_segment->jobs[node_slot].limit = node_segment->budget/(count+1);
+	ctl->power_limit = node_segment->jobs[node_slot].limit;
+	node_unlock();
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Node budget %lf Watt shared by %d processes - power limit %lf Watt\n", node_segment->budget, count+1, ctl->power_limit);
+	#endif
+}
+
+void shutdown_node_budget(){
+
+	if(node_slot == -1)
+		return;
+
+	node_lock();
+	node_release(node_slot);
+	node_unlock();
+
+	munmap(node_segment, sizeof(node_segment_t));
+	close(node_fd);
+	node_slot = -1;
+}
+
+// Called by heuristic() at each round. Publishes the marginal throughput of the process, arbitrates if due and applies the limit of the process
+void node_budget_round(double throughput){
+
+	node_job_t* job;
+	double step, current, limit;
+	long now;
+
+	if(node_slot == -1)
+		return;
+
+	node_lock();
+	job = &node_segment->jobs[node_slot];
+	step = node_segment->budget/node_live_jobs()*NODE_STEP_FRACTION;
+
+	// Relative to the measured throughput when no sampled configuration is within the limit
+	current = node_frontier_throughput(job->limit);
+	if(current <= 0)
+		current = throughput;
+
+	job->gain = (node_frontier_throughput(job->limit + step) - node_frontier_throughput(job->limit))/current/step;
+	job->loss = (node_frontier_throughput(job->limit) - node_frontier_throughput(job->limit - step))/current/step;
+	job->ready = job->limit == ctl->power_limit && (ctl->stopped_searching || ctl->heuristic_mode == 18) && declared_phases() == 0;
+
+	now = get_time();
+	if(now - node_segment->last_arbitration >= (long) (node_period*1000000)){
+		node_segment->last_arbitration = now;
+		node_reclaim();
+		node_arbitrate();
+	}
+
+	limit = job->limit;
+	node_unlock();
+
+	if(limit != ctl->power_limit)
+		__atomic_store(&pending_power_limit, &limit, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,63 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Optimization objectives
+///////////////////////////////////////////////////////////////
+
+// The heuristics compare configurations by the score returned by objective_score(), the higher the better, and power_limit stays
+// a constraint for every objective. Since all scores grow with throughput and decrease with power, the best configuration within
+// power_limit is always a point of the Pareto frontier. With objective 0 the score is the throughput, as before the objectives.
+// With objectives 1 to 3 it is the inverse of the energy per commit, of the energy-delay product and of the energy-delay squared
+// product per commit, so the heuristics settle below power_limit when running faster costs more energy than it saves.
+// With objective 4 it is the throughput while the energy per commit is within energy_budget Joule, and it decreases proportionally
+// to the excess above the budget. Heuristics 9 to 14, 16 and 17, Thompson sampling and the uncore search receive the score in place of
+// the throughput, while the models of heuristics 15 and 18 learn the throughput and score their predictions. The search of the
+// frequency of heuristic 12 and the selection by number of threads of heuristics 11 and 16 are unchanged, as they assume the throughput objective.
+// The exploitation runs at the best configuration without fluctuating around power_limit, which only pays off for the throughput.
+
+#define OBJECTIVE_THROUGHPUT 0		// Highest throughput
+#define OBJECTIVE_ENERGY 1			// Lowest energy per commit
+#define OBJECTIVE_EDP 2				// Lowest energy-delay product per commit
+#define OBJECTIVE_ED2P 3			// Lowest energy-delay squared product per commit
+#define OBJECTIVE_ENERGY_BUDGET 4	// Highest throughput with energy per commit within energy_budget
+
+double objective_score(double throughput, double power){
+
+	double energy_per_commit;
+
+	// Keeps the sentinel values of configurations not sampled yet
+	if(throughput <= 0 || power <= 0)
+		return throughput;
+
+	switch(ctl->objective){
+		case OBJECTIVE_ENERGY:
+			return throughput/power;
+		case OBJECTIVE_EDP:
+			return throughput*throughput/power;
+		case OBJECTIVE_ED2P:
+			return throughput*throughput*throughput/power;
+		case OBJECTIVE_ENERGY_BUDGET:
+			energy_per_commit = power/throughput;
+			return energy_per_commit <= ctl->energy_budget ? throughput : throughput*ctl->energy_budget/energy_per_commit;
+		default:
+			return throughput;
+	}
+}
+
+char* objective_suffix(){
+
+	switch(ctl->objective){
+		case OBJECTIVE_ENERGY:
+			return "-energy";
+		case OBJECTIVE_EDP:
+			return "-edp";
+		case OBJECTIVE_ED2P:
+			return "-ed2p";
+		case OBJECTIVE_ENERGY_BUDGET:
+			return "-eb";
+		default:
+			return "";
+	}
+}
@@ -0,0 +1,293 @@
+#include "powercap.h"
+#include <stdlib.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Sampled configurations and Pareto frontier
+///////////////////////////////////////////////////////////////
+
+// Every step measured by heuristic() updates the mean throughput and power of its configuration, weighted by at most
+// PARETO_MAX_WEIGHT steps so that the means follow workload changes. The Pareto frontier is the set of sampled configurations
+// with no other configuration with higher throughput at lower or equal power. It is recomputed only when queried after a
+// change of the samples, by sorting the sampled configurations by power and keeping the ones that increase the throughput.
+// When power_limit changes at runtime, the best configuration becomes the frontier point with the highest score within
+// the new limit, without exploring again. The exploration restarts only if no sampled configuration is within the new limit.
+
+#define PARETO_MAX_WEIGHT 16
+
+typedef struct pareto_point{
+	int threads;
+	int pstate;
+	double throughput;
+	double power;
+} pareto_point_t;
+
+// Sampled configurations of a controller
+typedef struct pareto_state{
+	double** sampled_weight;			// Rows are p-states, columns are threads, as the model matrices
+	double** sampled_throughput;
+	double** sampled_power;
+	pareto_point_t* frontier;			// Frontier points by increasing power and throughput
+	int frontier_size;
+	int frontier_dirty;					// Set when the samples changed since the frontier was computed
+} pareto_state_t;
+
+static double pending_power_limit;	// Power limit set with the asynchronous controller, applied by the next heuristic() call. 0 if none
+
+static double** pareto_alloc_matrix(){
+
+	double** matrix = malloc(sizeof(double*)*(max_pstate+1));
+	int i;
+
+	for(i = 0; i <= max_pstate; i++)
+		matrix[i] = calloc(total_threads+1, sizeof(double));
+
+	return matrix;
+}
+
+void init_pareto(){
+
+	pareto_state_t* pareto;
+
+	if(ctl->pareto != NULL)
+		return;
+
+	pareto = ctl->pareto = malloc(sizeof(pareto_state_t));
+	pareto->sampled_weight = pareto_alloc_matrix();
+	pareto->sampled_throughput = pareto_alloc_matrix();
+	pareto->sampled_power = pareto_alloc_matrix();
+	pareto->frontier = malloc(sizeof(pareto_point_t)*(max_pstate+1)*total_threads);
+	pareto->frontier_size = 0;
+	pareto->frontier_dirty = 0;
+}
+
+void free_pareto(controller_t* controller){
+
+	int i;
+
+	if(controller->pareto == NULL)
+		return;
+
+	for(i = 0; i <= max_pstate; i++){
+		free(controller->pareto->sampled_weight[i]);
+		free(controller->pareto->sampled_throughput[i]);
+		free(controller->pareto->sampled_power[i]);
+	}
+	free(controller->pareto->sampled_weight);
+	free(controller->pareto->sampled_throughput);
+	free(controller->pareto->sampled_power);
+	free(controller->pareto->frontier);
+	free(controller->pareto);
+	controller->pareto = NULL;
+}
+
+// Accumulates the throughput and power of a step at the given configuration
+void pareto_add_sample(int input_pstate, int threads, double throughput, double power){
+
+	pareto_state_t* pareto = ctl->pareto;
+	double* weight;
+
+	if(pareto == NULL || input_pstate < 0 || input_pstate > max_pstate || threads < 1 || threads > total_threads || throughput <= 0 || power <= 0)
+		return;
+
+	weight = &pareto->sampled_weight[input_pstate][threads];
+	if(*weight < PARETO_MAX_WEIGHT)
+		*weight += 1;
+
+	pareto->sampled_throughput[input_pstate][threads] += (throughput - pareto->sampled_throughput[input_pstate][threads])/(*weight);
+	pareto->sampled_power[input_pstate][threads] += (power - pareto->sampled_power[input_pstate][threads])/(*weight);
+	pareto->frontier_dirty = 1;
+}
+
+// Sets the means of a configuration measured by a previous run
+void pareto_load_sample(int input_pstate, int threads, double weight, double throughput, double power){
+
+	pareto_state_t* pareto = ctl->pareto;
+
+	if(input_pstate < 0 || input_pstate > max_pstate || threads < 1 || threads > total_threads || weight <= 0)
+		return;
+
+	pareto->sampled_weight[input_pstate][threads] = weight < PARETO_MAX_WEIGHT ? weight : PARETO_MAX_WEIGHT;
+	pareto->sampled_throughput[input_pstate][threads] = throughput;
+	pareto->sampled_power[input_pstate][threads] = power;
+	pareto->frontier_dirty = 1;
+}
+
+// Returns the weight of a configuration, 0 if never sampled, and its mean throughput and power
+double pareto_sample(int input_pstate, int threads, double* throughput, double* power){
+
+	pareto_state_t* pareto = ctl->pareto;
+
+	*throughput = pareto->sampled_throughput[input_pstate][threads];
+	*power = pareto->sampled_power[input_pstate][threads];
+	return pareto->sampled_weight[input_pstate][threads];
+}
+
+static int pareto_compare(const void* a, const void* b){
+
+	const pareto_point_t* x = (const pareto_point_t*) a;
+	const pareto_point_t* y = (const pareto_point_t*) b;
+
+	if(x->power != y->power)
+		return x->power < y->power ? -1 : 1;
+	if(x->throughput != y->throughput)
+		return x->throughput > y->throughput ? -1 : 1;
+	return 0;
+}
+
+static void pareto_update(){
+
+	pareto_state_t* pareto = ctl->pareto;
+	int i, j, sampled = 0, kept = 0;
+
+	if(!pareto->frontier_dirty)
+		return;
+
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			if(pareto->sampled_weight[i][j] > 0){
+				pareto->frontier[sampled].threads = j;
+				pareto->frontier[sampled].pstate = i;
+				pareto->frontier[sampled].throughput = pareto->sampled_throughput[i][j];
+				pareto->frontier[sampled].power = pareto->sampled_power[i][j];
+				sampled++;
+			}
+		}
+	}
+
+	qsort(pareto->frontier, sampled, sizeof(pareto_point_t), pareto_compare);
+
+	for(i = 0; i < sampled; i++){
+		if(kept == 0 || pareto->frontier[i].throughput > pareto->frontier[kept-1].throughput)
+			pareto->frontier[kept++] = pareto->frontier[i];
+	}
+
+	pareto->frontier_size = kept;
+	pareto->frontier_dirty = 0;
+}
+
+// Number of points of the Pareto frontier
+int pareto_frontier_size(){
+
+	pareto_state_t* pareto = ctl->pareto;
+
+	pareto_update();
+	return pareto->frontier_size;
+}
+
+// Returns the given frontier point, by increasing power. Returns 0 if the index is out of the frontier
+int pareto_frontier_point(int index, int* threads, int* input_pstate, double* throughput, double* power){
+
+	pareto_state_t* pareto = ctl->pareto;
+
+	pareto_update();
+	if(index < 0 || index >= pareto->frontier_size)
+		return 0;
+
+	*threads = pareto->frontier[index].threads;
+	*input_pstate = pareto->frontier[index].pstate;
+	*throughput = pareto->frontier[index].throughput;
+	*power = pareto->frontier[index].power;
+	return 1;
+}
+
+// Index of the frontier point with the highest score of the objective within the given limit, -1 if none
+int pareto_best_within(double limit){
+
+	pareto_state_t* pareto = ctl->pareto;
+	int i, best = -1;
+
+	pareto_update();
+	for(i = 0; i < pareto->frontier_size && pareto->frontier[i].power <= limit; i++){
+		if(best == -1 || objective_score(pareto->frontier[i].throughput, pareto->frontier[i].power) > objective_score(pareto->frontier[best].throughput, pareto->frontier[best].power))
+			best = i;
+	}
+
+	return best;
+}
+
+void print_pareto_stats(FILE* fd){
+
+	pareto_state_t* pareto = ctl->pareto;
+	int i;
+
+	pareto_update();
+	for(i = 0; i < pareto->frontier_size; i++)
+		fprintf(fd, "%s%d/%d/%lf/%lf", i == 0 ? "" : ",", pareto->frontier[i].threads, pareto->frontier[i].pstate, pareto->frontier[i].throughput, pareto->frontier[i].power);
+}
+
+// Moves to the frontier point of the new power limit. Must be called by the thread that calls heuristic()
+void retarget_power_limit(double limit){
+
+	pareto_state_t* pareto = ctl->pareto;
+	int point;
+
+	ctl->power_limit = limit;
+	set_hw_power_limit(limit);
+
+	// Before the end of the ramp up, with a static configuration and with phases there is no configuration to retarget
+	if(current_ramp_up_commits < ramp_up_commits || ctl->heuristic_mode == 8 || declared_phases() > 0)
+		return;
+
+	point = pareto_best_within(limit);
+
+	#ifdef DEBUG_HEURISTICS
+		printf("POWER LIMIT SET TO %lf Watt - frontier point %d of %d\n", limit, point, pareto->frontier_size);
+	#endif
+
+	// While exploring and with heuristic 18 the heuristic follows power_limit by itself
+	if(!ctl->stopped_searching){
+		if(ctl->heuristic_mode == 18 && point >= 0){
+			set_pstate(pareto->frontier[point].pstate);
+			set_threads(pareto->frontier[point].threads);
+		}
+		return;
+	}
+
+	if(point < 0){
+		restart_exploration();
+		return;
+	}
+
+	ctl->best_threads = pareto->frontier[point].threads;
+	ctl->best_pstate = pareto->frontier[point].pstate;
+	ctl->best_throughput = objective_score(pareto->frontier[point].throughput, pareto->frontier[point].power);
+	ctl->best_power = pareto->frontier[point].power;
+	duty_cycle_reset();
+	stop_searching();
+}
+
+// Returns 1 if a power limit set with the asynchronous controller was applied, so the sample of the round must be discarded
+int apply_pending_power_limit(){
+
+	double limit = 0, none = 0;
+
+	__atomic_exchange(&pending_power_limit, &none, &limit, __ATOMIC_ACQ_REL);
+	if(limit <= 0)
+		return 0;
+
+	retarget_power_limit(limit);
+	return 1;
+}
+
+
+/////////////////////////////////////////////////////////////
+// EXTERNAL API
+/////////////////////////////////////////////////////////////
+
+// Changes power_limit at runtime. Without the asynchronous controller it must be called by the thread that calls powercap_commit_work()
+void powercap_set_power_limit(double limit){
+
+	if(limit <= 0){
+		printf("Power limit %lf is invalid, it must be higher than 0 Watt\n", limit);
+		return;
+	}
+
+	if(async_controller)
+		__atomic_store(&pending_power_limit, &limit, __ATOMIC_RELEASE);
+	else{
+		retarget_power_limit(limit);
+		barrier_detected = 1;	// The current round started at the previous configuration, it is discarded
+	}
+}
@@ -0,0 +1,225 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Application phases
+///////////////////////////////////////////////////////////////
+
+// With phase_aware the application marks its phases with powercap_phase_begin() and powercap_phase_end(), and each phase
+// learns its own configuration instead of the whole iteration sharing the one chosen by the heuristic, which is not called.
+// A phase starts at the configuration running at its first visit and is sampled over consecutive visits for at least
+// phase_sample_time milliseconds, taking visits per second as throughput. Each phase then climbs independently: the neighbors
+// of its best configuration with one p-state or one thread more or less are sampled in turn, and a neighbor with higher
+// score of the objective within power_limit becomes the new best. Since every phase stays within power_limit, so does the whole execution.
+// When no neighbor improves, the phase keeps running at its best configuration and restarts the climb if its power exceeds power_limit.
+// The number of threads changes only at the next parallel region, so it is tuned only for phases marked outside of parallel regions
+// or with core packing. Markers inside a parallel region must be called by a single thread, as with #pragma omp master.
+
+#define MAX_PHASES 16
+#define PHASE_NEIGHBORS 4
+
+typedef struct app_phase{
+	int declared;				// Set at the first visit
+	int adjust_threads;			// 1 if the phase can change the number of threads
+	int threads;				// Configuration applied at the begin of the phase
+	int pstate;
+	int best_threads;			// Best configuration found so far, with its throughput and power
+	int best_pstate;
+	double best_throughput;		// Expressed as visits per second, -1 if not sampled yet
+	double best_power;
+	int previous_threads;		// Previous best configuration, not sampled again as a neighbor
+	int previous_pstate;
+	int neighbor;				// Neighbor of the best configuration sampled next, PHASE_NEIGHBORS when the climb converged
+	long start_time;			// Time and energy at the begin of the current visit
+	long start_energy;
+	int sample_visits;			// Visits, time and energy of the current sample
+	long sample_time;
+	long sample_energy;
+	long visits;				// Visits and time of the whole execution, reported in the stats file
+	long time;
+} app_phase_t;
+
+static app_phase_t app_phases[MAX_PHASES];
+static int current_app_phase = -1;
+
+// Returns 1 and sets the configuration of the given neighbor of the best configuration if it is valid
+static int phase_neighbor(app_phase_t* app_phase, int index, int* threads, int* input_pstate){
+
+	*threads = app_phase->best_threads;
+	*input_pstate = app_phase->best_pstate;
+
+	switch(index){
+		case 0: (*input_pstate)--; break;
+		case 1: (*threads)++; break;
+		case 2: (*input_pstate)++; break;
+		case 3: (*threads)--; break;
+	}
+
+	if(*threads != app_phase->best_threads && !app_phase->adjust_threads)
+		return 0;
+	if(*threads == app_phase->previous_threads && *input_pstate == app_phase->previous_pstate)
+		return 0;
+
+	return *threads >= 1 && *threads <= total_threads && *input_pstate >= 0 && *input_pstate <= max_pstate;
+}
+
+// Returns 1 if the sampled configuration is better than the best one
+static int phase_improves(app_phase_t* app_phase, double throughput, double power){
+
+	if(app_phase->best_power > ctl->power_limit)
+		return power < app_phase->best_power;
+
+	return power <= ctl->power_limit && objective_score(throughput, power) > objective_score(app_phase->best_throughput, app_phase->best_power);
+}
+
+static void phase_update(int id, double throughput, double power){
+
+	app_phase_t* app_phase = &app_phases[id];
+	int threads, input_pstate;
+
+	if(app_phase->threads == app_phase->best_threads && app_phase->pstate == app_phase->best_pstate){
+		app_phase->best_throughput = throughput;
+		app_phase->best_power = power;
+		if(app_phase->neighbor == PHASE_NEIGHBORS && power > ctl->power_limit){
+			app_phase->neighbor = 0;
+
+			#ifdef DEBUG_HEURISTICS
+				printf("Phase %d - power %lf over the limit, restarting the search\n", id, power);
+			#endif
+		}
+	}else if(phase_improves(app_phase, throughput, power)){
+		app_phase->previous_threads = app_phase->best_threads;
+		app_phase->previous_pstate = app_phase->best_pstate;
+		app_phase->best_threads = app_phase->threads;
+		app_phase->best_pstate = app_phase->pstate;
+		app_phase->best_throughput = throughput;
+		app_phase->best_power = power;
+		app_phase->neighbor = 0;
+
+		#ifdef DEBUG_HEURISTICS
+			printf("Phase %d - moved to %d threads - p-state %d - throughput %lf - power %lf\n", id, app_phase->best_threads, app_phase->best_pstate, throughput, power);
+		#endif
+	}else{
+		app_phase->neighbor++;
+	}
+
+	while(app_phase->neighbor < PHASE_NEIGHBORS && !phase_neighbor(app_phase, app_phase->neighbor, &threads, &input_pstate))
+		app_phase->neighbor++;
+
+	if(app_phase->neighbor < PHASE_NEIGHBORS){
+		app_phase->threads = threads;
+		app_phase->pstate = input_pstate;
+	}else{
+		app_phase->threads = app_phase->best_threads;
+		app_phase->pstate = app_phase->best_pstate;
+	}
+}
+
+// Number of phases declared by the application, 0 if the heuristic drives the configuration
+int declared_phases(){
+
+	int i, count = 0;
+
+	for(i = 0; i < MAX_PHASES; i++)
+		count += app_phases[i].declared;
+
+	return count;
+}
+
+void print_phase_stats(FILE* fd){
+
+	int i, first = 1;
+
+	for(i = 0; i < MAX_PHASES; i++){
+		if(!app_phases[i].declared)
+			continue;
+		fprintf(fd, "%s%d:%d/%d/%lf", first ? "" : ",", i, app_phases[i].best_threads, app_phases[i].best_pstate, ((double) app_phases[i].time)/1000000000);
+		first = 0;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////
+// EXTERNAL API
+/////////////////////////////////////////////////////////////
+
+void powercap_phase_begin(int id){
+
+	app_phase_t* app_phase;
+
+	// Phases are ignored during the ramp up and with the static configuration of heuristic 8
+	if(!phase_aware || ctl->heuristic_mode == 8 || current_ramp_up_commits < ramp_up_commits)
+		return;
+
+	if(id < 0 || id >= MAX_PHASES){
+		printf("Phase id %d is invalid, it must be in the range from 0 to %d\n", id, MAX_PHASES-1);
+		exit(1);
+	}
+
+	app_phase = &app_phases[id];
+	if(!app_phase->declared){
+		app_phase->declared = 1;
+		app_phase->adjust_threads = core_packing || !omp_in_parallel();
+		app_phase->threads = active_threads;
+		app_phase->pstate = current_pstate;
+		app_phase->best_threads = active_threads;
+		app_phase->best_pstate = current_pstate;
+		app_phase->best_throughput = -1;
+		app_phase->previous_threads = -1;
+		app_phase->previous_pstate = -1;
+		app_phase->neighbor = 0;
+
+		#ifdef DEBUG_HEURISTICS
+			printf("Phase %d declared at %d threads - p-state %d - threads %s\n", id, active_threads, current_pstate, app_phase->adjust_threads ? "tuned" : "fixed");
+		#endif
+	}
+
+	// The configuration of the phase replaces the alternation of duty cycling
+	if(duty_cycle_active())
+		duty_cycle_reset();
+
+	if(app_phase->adjust_threads && app_phase->threads != active_threads)
+		set_threads(app_phase->threads);
+	if(app_phase->pstate != current_pstate)
+		set_pstate(app_phase->pstate);
+
+	current_app_phase = id;
+	app_phase->start_time = get_time();
+	app_phase->start_energy = get_energy();
+}
+
+void powercap_phase_end(){
+
+	app_phase_t* app_phase;
+	long time_interval, energy_interval;
+	double throughput, power;
+
+	if(current_app_phase == -1)
+		return;
+
+	app_phase = &app_phases[current_app_phase];
+	time_interval = get_time() - app_phase->start_time;
+	energy_interval = get_energy() - app_phase->start_energy;
+
+	app_phase->visits++;
+	app_phase->time += time_interval;
+	app_phase->sample_visits++;
+	app_phase->sample_time += time_interval;
+	app_phase->sample_energy += energy_interval;
+
+	if(app_phase->sample_time >= (long) (phase_sample_time*1000000)){
+		throughput = ((double) app_phase->sample_visits) / (((double) app_phase->sample_time)/ 1000000000);
+		power = ((double) app_phase->sample_energy) / (((double) app_phase->sample_time)/ 1000);
+
+		// A sample with no energy means the counters were not updated yet
+		if(power > 0)
+			phase_update(current_app_phase, throughput, power);
+
+		app_phase->sample_visits = 0;
+		app_phase->sample_time = 0;
+		app_phase->sample_energy = 0;
+	}
+
+	current_app_phase = -1;
+}
@@ -6,155 +6,35 @@
 #include <time.h>
 #include <signal.h>
 #include <sched.h>
+#include "model.c"
 #include "heuristics.c"
+#include "bayesian.c"
+#include "mpc.c"
+#include "bandit.c"
+#include "changepoint.c"
+#include "msr.c"
+#include "dvfs.c"
+#include "energy.c"
+#include "sim.c"
+#include "backend.c"
+#include "uncore.c"
+#include "rapl_limit.c"
+#include "pareto.c"
+#include "cache.c"
 #include <omp.h>
+#include "controller.c"
+#include "phases.c"
+#include "dutycycle.c"
+#include "control.c"
+#include "node.c"
+#include "objective.c"
+#include "controller_state.c"
+#include "trace.c"
 
 
-int set_pstate(int input_pstate){
-	
-	int i;
-	char fname[64];
-	FILE* frequency_file;
-	
-	if(input_pstate > max_pstate)
-		return -1;
-	
-	if(current_pstate != input_pstate){
-		int frequency = pstate[input_pstate];
-
-		for(i=0; i<nb_cores; i++){
-			sprintf(fname, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_setspeed", i);
-			frequency_file = fopen(fname,"w+");
-			if(frequency_file == NULL){
-				printf("Error opening cpu%d scaling_setspeed file. Must be superuser\n", i);
-				exit(0);		
-			}		
-			fprintf(frequency_file, "%d", frequency);
-			fflush(frequency_file);
-			fclose(frequency_file);
-		}
-		current_pstate = input_pstate;
-	}
-	return 0;
-}
-
-// Sets the governor to userspace and sets the highest frequency
-int init_DVFS_management(){
-	
-	char fname[64];
-	char* freq_available;
-	int frequency, i;
-	FILE* governor_file;
-
-	//Set governor to userspace
-	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
-	for(i=0; i<nb_cores;i++){
-		sprintf(fname, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", i);
-		governor_file = fopen(fname,"w+");
-		if(governor_file == NULL){
-			printf("Error opening cpu%d scaling_governor file. Must be superuser\n", i);
-			exit(0);		
-		}		
-		fprintf(governor_file, "userspace");
-		fflush(governor_file);
-		fclose(governor_file);
-	}
-
-	// Init array of available frequencies
-	FILE* available_freq_file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_available_frequencies","r");
-	if(available_freq_file == NULL){
-		printf("Cannot open scaling_available_frequencies file\n");
-		exit(0);
-	}
-	freq_available = malloc(sizeof(char)*256);
-	fgets(freq_available, 256, available_freq_file);
-	
-	pstate = malloc(sizeof(int)*32);
-	i = 0; 
-	char * end;
-
-	for (frequency = strtol(freq_available, &end, 10); freq_available != end; frequency = strtol(freq_available, &end, 10)){
-		pstate[i]=frequency;
-		freq_available = end;
-		i++;
-	}
-	max_pstate = --i;
-
-	#ifdef DEBUG_HEURISTICS
-	printf("Found %d p-states in the range from %d MHz to %d MHz\n", max_pstate, pstate[max_pstate]/1000, pstate[0]/1000);
-  	#endif
-	fclose(available_freq_file);
-
-	current_pstate = -1;
-	set_pstate(max_pstate);
-
-	set_boost(boost_disabled);
-
-	return 0;
-}
-
-// Sets the governor to userspace and sets the highest frequency
-int init_DVFS_management_intel_pstate_passive_mode(){
-	
-	char fname[64];
-	int frequency, i;
-	FILE* governor_file;
-
-	//Set governor to userspace
-	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
-	printf("Number of available cores: %i\n ", nb_cores);	
-	for(i=0; i<nb_cores;i++){
-		sprintf(fname, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", i);
-		governor_file = fopen(fname,"w+");
-		if(governor_file == NULL){
-			printf("Error opening cpu%d scaling_governor file. Must be superuser\n", i);
-			exit(0);		
-		}		
-		fprintf(governor_file, "userspace");
-		fflush(governor_file);
-		fclose(governor_file);
-	}
-
-	// Init array of available frequencies
-
-	pstate = malloc(sizeof(int)*32);
-	i = (max_cpu_freq-min_cpu_freq)/100000i+1; 
-	char * end;
-	printf("\nCreating Cpu frequency list with %i p-states\n",i);
-	max_pstate = --i;
-	frequency=min_cpu_freq;
-	while(frequency<=max_cpu_freq) {
-		pstate[i]=frequency;
-		printf(" pstate[%i]:%i",i,pstate[i]);
-		frequency+=100000;
-		i--;
-	}
-	//set pstate 0
-	if (boost_disabled) frequency-=100000;
-	pstate[i]=frequency;
-	printf(" pstate[%i]:%i",i,pstate[i]);
-	if (boost_disabled) printf("(disabled)");
-
-	printf("\nCpu frequency list completed\n");
-
-	#ifdef DEBUG_HEURISTICS
-	printf("Created %d p-states in the range from %d MHz to %d MHz\n", max_pstate+1, pstate[max_pstate]/1000, pstate[0]/1000);
-  	#endif
-	
-	current_pstate = -1;
-	set_pstate(max_pstate);
-
-	return 0;
-}
-
 // Executed inside stm_init
 void init_thread_management(int threads){
 
-	char* filename;
-	FILE* numafile;
-	int package_last_core;
-	int i;
-
 	// Init total threads and active threads
 	nas_total_threads = threads;
 	total_threads = threads - 1;
@@ -165,32 +45,13 @@ void init_thread_management(int threads){
 	#endif
 
 	active_threads = total_threads;
+	ctl->active_threads = total_threads;
 	pthread_ids = malloc(sizeof(pthread_t)*nas_total_threads);
-
-	//init number of packages
-	filename = malloc(sizeof(char)*64); 
-	sprintf(filename,"/sys/devices/system/cpu/cpu%d/topology/physical_package_id", nb_cores-1);
-	numafile = fopen(filename,"r");
-	if (numafile == NULL){
-		printf("Cannot read number of packages\n");
-		exit(1);
-	} 
-	fscanf(numafile ,"%d", &package_last_core);
-	nb_packages = package_last_core+1;
-
-	#ifdef DEBUG_HEURISTICS
-	printf("Number of packages detected: %d\n", nb_packages);
-	#endif
 }
 
 
-// Function used to set the number of running threads. Based on active_threads and threads might wake up or pause some threads 
-void set_threads(int to_threads){
-
-	if(to_threads < 1 || to_threads > total_threads){
-		printf("Setting threads/cores to %d which is invalid for this system\n", to_threads);
-		exit(1);
-	}
+// Schedules the given number of threads, either packing them on cores or changing the number of OpenMP threads. Used by all the backends
+void schedule_threads(int to_threads){
 
 	if (core_packing) {
 
@@ -208,16 +69,35 @@ void set_threads(int to_threads){
 		for(i = 0; i < nas_total_threads;i++){
 			pthread_setaffinity_np(pthread_ids[i], sizeof(cpu_set_t), &cpu_set); 
 		}
+		packed_cores = to_threads;
 		
 	} else {
 		#ifdef DEBUG_HEURISTICS
 		printf("Scheduling %d threads\n", to_threads);
 		#endif
 		//omp_set_dynamic(0);     // Explicitly disable dynamic teams
-		omp_set_num_threads(to_threads);
+		if(in_controller_thread())
+			pending_threads = to_threads;	// Applied by the master thread at the next powercap_commit_work()
+		else
+			omp_set_num_threads(to_threads);
+	}
+}
+
+// Actuator of main_controller used to set the number of running threads. Based on active_threads and threads might wake up or pause some threads 
+void apply_threads(int to_threads){
+
+	if(to_threads < 1 || to_threads > total_threads){
+		printf("Setting threads/cores to %d which is invalid for this system\n", to_threads);
+		exit(1);
 	}
 
+	backend->set_threads(to_threads);
+
 	active_threads = to_threads;
+
+	// Parked cores are moved to idle_pstate, newly packed cores to current_pstate
+	if(dvfs_domain != 0)
+		update_core_pstates();
 }
 
 // Executed inside stm_init
@@ -262,8 +142,8 @@ void load_config_file(){
 		printf("Error opening powercap_config configuration file.\n");
 		exit(1);
 	}
-	if (fscanf(config_file, "STARTING_THREADS=%d STATIC_PSTATE=%d POWER_LIMIT=%lf COMMITS_ROUND=%d HEURISTIC_MODE=%d DETECTION_MODE=%d EXPLOIT_STEPS=%d POWER_UNCORE=%lf MIN_CPU_FREQ=%d MAX_CPU_FREQ=%d BOOST_DISABLED=%d CORE_PACKING=%d EXTRA_RANGE_PERCENTAGE=%lf WINDOW_SIZE=%d HYSTERESIS=%lf RAMP_UP_COMMITS=%d LOWER_SAMPLED_MODEL_PSTATE=%d", 
-		&starting_threads, &static_pstate, &power_limit, &total_commits_round, &heuristic_mode, &detection_mode, &exploit_steps, &power_uncore, &min_cpu_freq, &max_cpu_freq, &boost_disabled, &core_packing, &extra_range_percentage, &window_size, &hysteresis, &ramp_up_commits, &lower_sampled_model_pstate)!=17) {
+	if (fscanf(config_file, "STARTING_THREADS=%d STATIC_PSTATE=%d POWER_LIMIT=%lf COMMITS_ROUND=%d HEURISTIC_MODE=%d DETECTION_MODE=%d EXPLOIT_STEPS=%d POWER_UNCORE=%lf MIN_CPU_FREQ=%d MAX_CPU_FREQ=%d BOOST_DISABLED=%d CORE_PACKING=%d EXTRA_RANGE_PERCENTAGE=%lf WINDOW_SIZE=%d HYSTERESIS=%lf RAMP_UP_COMMITS=%d LOWER_SAMPLED_MODEL_PSTATE=%d SYSFS_ROOT=%255s ASYNC_CONTROLLER=%d POWER_BACKEND=%d MSR_ROOT=%255s SIM_ALFA=%lf SIM_BETA=%lf SIM_NOISE=%lf DVFS_DOMAIN=%d IDLE_PSTATE=%d UNCORE_SCALING=%d UNCORE_TOLERANCE=%lf HW_POWER_LIMIT=%d HW_TIME_WINDOW=%ld ROUND_DURATION=%lf ROUND_CONFIDENCE=%lf ROUND_MAX_SAMPLES=%d MODEL_FORGETTING=%lf MODEL_SAMPLED_THREADS=%d CHANGE_DELTA=%lf CHANGE_THRESHOLD=%lf SIM_PHASE_PERIOD=%lf SIM_PHASE_SCALE=%lf PHASE_AWARE=%d PHASE_SAMPLE_TIME=%lf CONFIG_CACHE=%d CACHE_DIR=%255s DUTY_CYCLING=%d DUTY_PERIOD=%lf CONTROL_SOCKET=%107s NODE_BUDGET=%lf NODE_FILE=%255s NODE_PERIOD=%lf OBJECTIVE=%d ENERGY_BUDGET=%lf TRACE_FILE=%255s", 
+		&ctl->starting_threads, &static_pstate, &ctl->power_limit, &total_commits_round, &ctl->heuristic_mode, &ctl->detection_mode, &exploit_steps, &power_uncore, &min_cpu_freq, &max_cpu_freq, &boost_disabled, &core_packing, &extra_range_percentage, &window_size, &hysteresis, &ramp_up_commits, &lower_sampled_model_pstate, sysfs_root, &async_controller, &power_backend, msr_root, &sim_alfa, &sim_beta, &sim_noise, &dvfs_domain, &idle_pstate, &uncore_scaling, &uncore_tolerance, &hw_power_limit, &hw_time_window, &round_duration, &round_confidence, &round_max_samples, &model_forgetting, &model_sampled_threads, &change_delta, &change_threshold, &sim_phase_period, &sim_phase_scale, &phase_aware, &phase_sample_time, &config_cache, cache_dir, &duty_cycling, &duty_period, control_socket, &node_budget, node_file, &node_period, &ctl->objective, &ctl->energy_budget, trace_file)!=52) {
 		printf("The number of input parameters of the configuration file does not match the number of required parameters.\n");
 		exit(1);
 	}
@@ -278,45 +158,102 @@ void load_config_file(){
 		exit(1);
 	}
 
-	if(ramp_up_commits < 1){
-		printf("Ramp_up_commits input parameter must be higher than 0\n");
+	if(power_backend < 0 || power_backend > 2){
+		printf("Power_backend must be 0 (RAPL and cpufreq sysfs), 1 (MSR) or 2 (simulated)\n");
 		exit(1);
 	}
 
-	fclose(config_file);
-}
+	if(dvfs_domain < 0 || dvfs_domain > 2){
+		printf("Dvfs_domain must be 0 (global), 1 (per core) or 2 (per package)\n");
+		exit(1);
+	}
+
+	if(dvfs_domain != 0 && !core_packing){
+		printf("Per core and per package DVFS require core packing to know which cores are parked. Using global DVFS\n");
+		dvfs_domain = 0;
+	}
 
+	if(uncore_tolerance < 0 || uncore_tolerance > 100){
+		printf("Uncore_tolerance value is not a percentage. Should be a floating point number in the range from 0 to 100\n");
+		exit(1);
+	}
 
-// Returns energy consumption of package 0 cores in micro Joule
-long get_energy(){
-	
-	long energy;
-	int i;
-	FILE* energy_file;
-	long total_energy = 0;
-	char fname[64];
+	if(hw_power_limit && hw_time_window <= 0){
+		printf("Hw_time_window must be higher than 0 micro seconds\n");
+		exit(1);
+	}
 
-	for(i = 0; i<nb_packages; i++){
+	if(round_duration < 0){
+		printf("Round_duration must be 0 to define rounds by commits_round or a number of milliseconds higher than 0\n");
+		exit(1);
+	}
 
-		// Package energy consumtion
-		sprintf(fname, "/sys/class/powercap/intel-rapl/intel-rapl:%d/energy_uj", i);
-		energy_file = fopen(fname, "r");
-		
-		// Cores energy consumption
-		//FILE* energy_file = fopen("/sys/class/powercap/intel-rapl/intel-rapl:0/intel-rapl:0:0/energy_uj", "r");	
+	if(round_confidence < 0 || round_confidence > 100){
+		printf("Round_confidence value is not a percentage. Should be a floating point number in the range from 0 to 100, 0 disables adaptive rounds\n");
+		exit(1);
+	}
 
-		// DRAM module, considered inside the package
-		//FILE* energy_file = fopen("/sys/class/powercap/intel-rapl/intel-rapl:0/intel-rapl:0:1/energy_uj", "r");	
+	if(round_confidence > 0 && round_max_samples < 2){
+		printf("Round_max_samples must be at least 2 with adaptive rounds\n");
+		exit(1);
+	}
 
-		if(energy_file == NULL){
-			printf("Error opening energy file\n");		
-		}
-		fscanf(energy_file,"%ld",&energy);
-		fclose(energy_file);
-		total_energy+=energy;
+	if(model_forgetting <= 0 || model_forgetting > 1){
+		printf("Model_forgetting must be in the range from 0 (excluded) to 1, 1 weights all the samples equally\n");
+		exit(1);
 	}
 
-	return total_energy;
+	if(model_sampled_threads == 1 || model_sampled_threads == 2){
+		printf("Model_sampled_threads must be 0 to sample all the thread counts or at least 3 to fit the scalability curve\n");
+		exit(1);
+	}
+
+	if(ctl->detection_mode < 0 || ctl->detection_mode > 5){
+		printf("Detection_mode must be 0 (disabled), 1, 2 (periodic exploration), 3 (model validation), 4 (Thompson sampling) or 5 (phase change detection)\n");
+		exit(1);
+	}
+
+	if(change_delta < 0 || change_threshold <= 0){
+		printf("Change_delta must be a non negative percentage and change_threshold a percentage higher than 0\n");
+		exit(1);
+	}
+
+	if(phase_aware && phase_sample_time <= 0){
+		printf("Phase_sample_time must be higher than 0 milliseconds with phase_aware\n");
+		exit(1);
+	}
+
+	if(duty_cycling && duty_period <= 0){
+		printf("Duty_period must be higher than 0 milliseconds with duty_cycling\n");
+		exit(1);
+	}
+
+	if(duty_cycling && async_controller){
+		printf("Duty cycling changes the p-state concurrently with the asynchronous controller. Disabling duty cycling\n");
+		duty_cycling = 0;
+	}
+
+	if(node_budget < 0 || (node_budget > 0 && node_period <= 0)){
+		printf("Node_budget must be a non negative power and node_period must be higher than 0 milliseconds\n");
+		exit(1);
+	}
+
+	if(ctl->objective < 0 || ctl->objective > 4 || (ctl->objective == 4 && ctl->energy_budget <= 0)){
+		printf("Objective must be in the range from 0 to 4, and energy_budget must be higher than 0 Joule with objective 4\n");
+		exit(1);
+	}
+
+	if(duty_cycling && ctl->objective != 0){
+		printf("Duty cycling runs at power_limit, which is the optimum of the throughput objective only. Disabling duty cycling\n");
+		duty_cycling = 0;
+	}
+
+	if(ramp_up_commits < 1){
+		printf("Ramp_up_commits input parameter must be higher than 0\n");
+		exit(1);
+	}
+
+	fclose(config_file);
 }
 
 
@@ -337,39 +274,50 @@ void init_model_matrices(){
 
 	int i;
 
+	if(ctl->power_model != NULL)
+		return;
+
 	// Allocate the matrices
-	power_model = (double**) malloc(sizeof(double*) * (max_pstate+1));
-	throughput_model = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
+	ctl->power_model = (double**) malloc(sizeof(double*) * (max_pstate+1));
+	ctl->throughput_model = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
 
 	// Allocate the validation matrices
-	power_validation = (double**) malloc(sizeof(double*) * (max_pstate+1));
-	throughput_validation = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
+	ctl->power_validation = (double**) malloc(sizeof(double*) * (max_pstate+1));
+	ctl->throughput_validation = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
 
 	// Allocate matrices to store real values during validation
-	power_real = (double**) malloc(sizeof(double*) * (max_pstate+1));
-	throughput_real = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
+	ctl->power_real = (double**) malloc(sizeof(double*) * (max_pstate+1));
+	ctl->throughput_real = (double**) malloc(sizeof(double*) * (max_pstate+1)); 
 
 	for (i = 0; i <= max_pstate; i++){
-		power_model[i] = (double *) malloc(sizeof(double) * (total_threads));
-		throughput_model[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->power_model[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->throughput_model[i] = (double *) malloc(sizeof(double) * (total_threads));
 
-		power_validation[i] = (double *) malloc(sizeof(double) * (total_threads));
-		throughput_validation[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->power_validation[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->throughput_validation[i] = (double *) malloc(sizeof(double) * (total_threads));
 
-		power_real[i] = (double *) malloc(sizeof(double) * (total_threads));
-		throughput_real[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->power_real[i] = (double *) malloc(sizeof(double) * (total_threads));
+		ctl->throughput_real[i] = (double *) malloc(sizeof(double) * (total_threads));
+	}
+
+	// Thread counts not sampled at max_pstate by a reduced setup have no real values
+	for(i = 1; i < total_threads; i++){
+		ctl->power_real[max_pstate][i] = 0;
+		ctl->throughput_real[max_pstate][i] = 0;
+		ctl->power_validation[max_pstate][i] = 0;
+		ctl->throughput_validation[max_pstate][i] = 0;
 	}
 
    	// Init first row with all zeros 
 	for(i = 0; i <= max_pstate; i++){
-		power_model[i][0] = 0;
-		throughput_model[i][0] = 0;
+		ctl->power_model[i][0] = 0;
+		ctl->throughput_model[i][0] = 0;
 
-		power_validation[i][0] = 0;
-		throughput_validation[i][0] = 0;
+		ctl->power_validation[i][0] = 0;
+		ctl->throughput_validation[i][0] = 0;
 
-		power_real[i][0] = 0;
-		throughput_real[i][0] = 0;
+		ctl->power_real[i][0] = 0;
+		ctl->throughput_real[i][0] = 0;
 	}
 }
 
@@ -381,34 +329,9 @@ void init_global_variables(){
 	#endif
 
 	round_completed=0;
-	old_throughput = -1;
-	old_power = -1;
-	old_energy_per_tx = -1;
-	level_best_throughput = -1; 
-	level_best_threads = 0;
-	level_starting_threads = starting_threads;
-	new_pstate = 1;
-	decreasing = 0;
-	stopped_searching = 0;
-	steps=0;
-	phase = 0; 
-	current_exploit_steps = 0;
 	barrier_detected = 0;
 	pre_barrier_threads = 0;
 
-
-	high_throughput = -1;
-	high_threads = -1;
-	high_pstate = -1;
-
-	best_throughput = -1;
-	best_pstate = -1;
-	best_threads = -1;
-
-	low_throughput = -1;
-	low_threads = -1;
-	low_pstate = -1;
-
 	net_time_sum = 0;
 	net_energy_sum = 0;
 	net_commits_sum = 0;
@@ -420,16 +343,20 @@ void init_global_variables(){
 	net_error_accumulator= 0; 
 	net_discard_barrier= 0;
 
-	min_pstate_search = 0;
-	max_pstate_search = max_pstate;
+	commit_overhead_time = 0;
+	commit_overhead_rounds = 0;
+
+	cache_warm_started = 0;
+
+	round_samples = 0;
+	round_lengths_count = 0;
+	round_lengths_size = 1024;
+	round_lengths_time = 0;
+	round_lengths = malloc(sizeof(int)*round_lengths_size);
 
-	min_thread_search = 1;
-	max_thread_search = total_threads;
-	min_thread_search_throughput = -1;
-	max_thread_search_throughput = -1;
 	current_ramp_up_commits = 0;
 
-	validation_pstate = max_pstate-1;
+	controller_init(&main_controller);
 	#ifdef DEBUG_HEURISTICS
 	printf("Global variables initialized\n");
 	fflush(stdout);
@@ -437,28 +364,61 @@ void init_global_variables(){
 }
 
 
-// Used to either enable or disable boosting facilities such as TurboBoost. Boost is disabled whenever the current config goes out of the powercap 
-void set_boost(int value){
+// Two-sided 95% quantile of the Student's t distribution with the given degrees of freedom
+double student_t95(int df){
 
-	int i;
-	char fname[64];
-	FILE* boost_file;
+	static const double t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262};
 
-	if(value != 0 && value != 1){
-		printf("Set_boost parameter invalid. Shutting down application\n");
-		exit(1);
-	}
-	
-	boost_file = fopen("/sys/devices/system/cpu/cpufreq/boost", "w+");
-	if(boost_file == NULL){
-		printf("Error opening boost_file\n", i);
-		exit(0);		
-	}
-	fprintf(boost_file, "%d", value);
-	fflush(boost_file);
-	fclose(boost_file);
+	if(df <= 9)
+		return t95[df-1];
+	return 1.96 + 2.4/df;	// Within 1% of the exact value for larger degrees of freedom
+}
 
-	return;
+// Adds a round to the current adaptive step. Returns 1 if the step is completed, because the 95% confidence intervals of throughput
+// and power are within round_confidence percent of their mean or round_max_samples rounds were merged, 0 if the step should be extended
+int adaptive_round_add_sample(double throughput, double power){
+
+	double delta, throughput_ci, power_ci;
+
+	round_samples++;
+
+	delta = throughput - round_throughput_mean;
+	round_throughput_mean += delta/round_samples;
+	round_throughput_m2 += delta*(throughput - round_throughput_mean);
+
+	delta = power - round_power_mean;
+	round_power_mean += delta/round_samples;
+	round_power_m2 += delta*(power - round_power_mean);
+
+	if(round_samples < 2)
+		return 0;
+	if(round_samples >= round_max_samples)
+		return 1;
+
+	throughput_ci = student_t95(round_samples-1)*sqrt(round_throughput_m2/(round_samples-1)/round_samples);
+	power_ci = student_t95(round_samples-1)*sqrt(round_power_m2/(round_samples-1)/round_samples);
+
+	return throughput_ci <= round_throughput_mean*round_confidence/100 && power_ci <= round_power_mean*round_confidence/100;
+}
+
+// Stores the number of samples of the step just completed and starts a new step
+void record_round_length(){
+
+	if(round_lengths_count == round_lengths_size){
+		round_lengths_size *= 2;
+		round_lengths = realloc(round_lengths, sizeof(int)*round_lengths_size);
+	}
+	round_lengths[round_lengths_count++] = round_samples;
+	round_lengths_time += round_time_sum;
+
+	round_samples = 0;
+	round_time_sum = 0;
+	round_energy_sum = 0;
+	round_commits_sum = 0;
+	round_throughput_mean = 0;
+	round_throughput_m2 = 0;
+	round_power_mean = 0;
+	round_power_m2 = 0;
 }
 
 
@@ -472,31 +432,31 @@ void powercap_init(int threads){
 	printf("CREATE called\n");
 	#endif
 
+	// The backends apply their initial p-state through main_controller
+	main_controller.apply_pstate = apply_pstate;
+	main_controller.apply_threads = apply_threads;
+
 	load_config_file();
-	init_DVFS_management();
+	init_node_budget();
+	init_backend(threads);
+	init_uncore_management();
+	init_hw_power_limit();
 	init_thread_management(threads);
 	init_stats_array_pointer(threads);
 	init_global_variables();	
+	init_controller();
+	init_duty_cycle();
+	init_control_socket();
+	init_trace();
 
-  	// Necessary for the static execution in order to avoid running for the first step with a different frequency than manually set in hope_config.txt
-	if(heuristic_mode == 8){
-		if(static_pstate >= 0 && static_pstate <= max_pstate)
-			set_pstate(static_pstate);
-		else 
-			printf("The parameter manual_pstate is set outside of the valid range for this CPU. Setting the CPU to the slowest frequency/voltage\n");
-	}else if(heuristic_mode == 12 || heuristic_mode == 13 || heuristic_mode == 15){
-		set_pstate(max_pstate);
-		starting_threads = 1;
-	}
-
-	if(heuristic_mode == 15)
-		init_model_matrices();
+	controller_start();
+	load_config_cache();
 
 	#ifdef DEBUG_HEURISTICS
-	printf("Heuristic mode: %d\n", heuristic_mode);
+	printf("Heuristic mode: %d\n", ctl->heuristic_mode);
 	#endif
 
-	if(starting_threads > total_threads){
+	if(ctl->starting_threads > total_threads){
 		printf("Starting threads set higher than total threads. Please modify this value in hope_config.txt\n");
 		exit(1);
 	}
@@ -534,24 +494,34 @@ void powercap_init_thread(){
 
 void powercap_commit_work(){
 
+	if(pending_threads)
+		apply_pending_threads();
+
 	// We discard first commits to allow application ramp up before measuring
 	if (current_ramp_up_commits < ramp_up_commits) {
 		current_ramp_up_commits++;
 		if(current_ramp_up_commits == ramp_up_commits){
-			set_threads(starting_threads);
+			if(!config_cache_warm_start())
+				set_threads(ctl->starting_threads);
 
 			// Init application wide counters
 			net_time_slot_start = get_time();
 			net_energy_slot_start = get_energy();
 			stats_ptr->start_time = net_time_slot_start;
 			stats_ptr->start_energy = net_energy_slot_start;
+			stats_ptr->start_epoch = config_epoch;
+			stats_ptr->end_time = net_time_slot_start + (long) (round_duration*1000000);
+			net_subdomain_time_start = net_time_slot_start;
+			net_core_energy_start = get_energy_core();
+			net_dram_energy_start = get_energy_dram();
 		}
 		return;
 	}
 
 	stats_ptr->commits++;
 
-	if(stats_ptr->commits >= stats_ptr->total_commits){
+	// With round_duration the round ends at the first commit after end_time, throughput is measured on the actual round length
+	if(round_duration > 0 ? get_time() >= stats_ptr->end_time : stats_ptr->commits >= stats_ptr->total_commits){
 
 		//Aggregate data and set reset_bits to 1 for all threads
 		double throughput, power;	// Expressed as critical sections per second and Watts respectively
@@ -575,10 +545,10 @@ void powercap_commit_work(){
 				long slot_energy_consumed = end_energy_slot - net_energy_slot_start;
 				double slot_power = (((double) slot_energy_consumed)/ (((double) slot_time_passed)/1000));
 
-				double error_signed = slot_power - power_limit;
+				double error_signed = slot_power - ctl->power_limit;
 				double error = 0;
 				if(error_signed > 0)
-					error = error_signed/power_limit*100;
+					error = error_signed/ctl->power_limit*100;
 
 				// Add the error to the accumulator
 				net_error_accumulator = (net_error_accumulator*((double)net_time_accumulator)+error*((double)slot_time_passed))/( ((double)net_time_accumulator)+( (double) slot_time_passed));
@@ -597,20 +567,56 @@ void powercap_commit_work(){
 			barrier_detected = 0;
 		}
 		else{
-			// We don't call the heuristic if the energy results are out or range due to an overflow 
+			// Wraparounds of the energy counters are corrected by get_energy(), a round with no energy means the counters were not updated yet 
 			if(power > 0){
 				net_time_sum += time_interval;
 				net_energy_sum += energy_interval;
 				net_commits_sum += commits_sum;
-
-				heuristic(throughput, power, time_interval);
+				trace_round(time_interval, energy_interval, (long) commits_sum);
+
+				sample_uncore_power(end_time_slot, end_energy_slot);
+
+				int step_completed = 1;
+				long step_epoch = stats_ptr->start_epoch;
+
+				// With adaptive rounds the heuristic receives throughput and power over all the rounds merged in the step
+				if(round_confidence > 0){
+					if(round_samples == 0)
+						round_start_epoch = stats_ptr->start_epoch;
+					round_time_sum += time_interval;
+					round_energy_sum += energy_interval;
+					round_commits_sum += stats_ptr->commits;
+
+					step_completed = adaptive_round_add_sample(throughput, power);
+					if(step_completed){
+						throughput = ((double) round_commits_sum) / (((double) round_time_sum)/ 1000000000);
+						power = ((double) round_energy_sum) / (((double) round_time_sum)/ 1000);
+						time_interval = round_time_sum;
+						step_epoch = round_start_epoch;
+						record_round_length();
+					}
+				}
+
+				// Once the application declared its phases, the configuration is chosen per phase by powercap_phase_begin()
+				if(step_completed && declared_phases() == 0){
+					if(async_controller)
+						controller_post_sample(throughput, power, time_interval, step_epoch);
+					else
+						heuristic(throughput, power, time_interval);
+				}
 			}
 		}
 
 		//Setup next round
 		stats_ptr->start_energy = get_energy();
 		stats_ptr->start_time = get_time();
+		stats_ptr->start_epoch = config_epoch;
+		stats_ptr->end_time = stats_ptr->start_time + (long) (round_duration*1000000);
 		stats_ptr->commits = 0;
+
+		// Time spent in powercap code by the committing thread at the end of the round
+		commit_overhead_time += stats_ptr->start_time - end_time_slot;
+		commit_overhead_rounds++;
 	}
 }
 
@@ -619,16 +625,25 @@ void powercap_commit_work(){
 
 void powercap_print_stats(){
 
+	shutdown_control_socket();
+	shutdown_node_budget();
+	shutdown_controller();
+	shutdown_duty_cycle();
+	restore_hw_power_limit();
+	save_config_cache();
+	shutdown_trace();
+
 #ifdef PRINT_STATS
 
 	extern char *__progname;
 
-	char fileName[32];
+	char fileName[64];
+	long i;
 
-	if (heuristic_mode==8)
+	if (ctl->heuristic_mode==8)
 		sprintf(fileName, "%s-%i-%i.txt", __progname, current_pstate, active_threads);
 	else 
-		sprintf(fileName, "%s-%i-%i.txt", __progname, heuristic_mode, (int)power_limit);
+		sprintf(fileName, "%s-%i-%i%s%s%s%s%s%s.txt", __progname, ctl->heuristic_mode, (int)ctl->power_limit, hw_power_limit ? "-hw" : "", ctl->detection_mode == 4 ? "-ts" : "", phase_aware ? "-ph" : "", duty_cycling ? "-dc" : "", node_budget > 0 ? "-nb" : "", objective_suffix());
 
 	printf ("\nWrinting stats to file: %s\n", fileName);
 	fflush(stdout);
@@ -644,8 +659,44 @@ void powercap_print_stats(){
 	double time_in_seconds = ( (double) net_time_sum) / 1000000000;
 	double net_throughput =  ( (double) net_commits_sum) / time_in_seconds;
 	double net_avg_power = ( (double) net_energy_sum) / (( (double) net_time_sum) / 1000);
+	double net_energy_per_commit = net_avg_power / net_throughput;		// Expressed in Joule
+	double net_edp = net_energy_per_commit / net_throughput;			// Expressed in Joule*second
+
+	// Core and DRAM power are averaged over the whole execution after the ramp up
+	double subdomain_time = ((double) (get_time() - net_subdomain_time_start)) / 1000;
+	double net_core_power = ((double) (get_energy_core() - net_core_energy_start)) / subdomain_time;
+	double net_dram_power = ((double) (get_energy_dram() - net_dram_energy_start)) / subdomain_time;
+
+	double commit_avg_overhead = 0;
+	if(commit_overhead_rounds > 0)
+		commit_avg_overhead = ((double) commit_overhead_time) / commit_overhead_rounds / 1000;
+
+	double dvfs_avg_latency = 0;
+	if(dvfs_transitions > 0)
+		dvfs_avg_latency = ((double) dvfs_latency_sum) / dvfs_transitions / 1000;
+
+	int uncore_frequency = 0;	// Expressed in MHz, 0 if uncore scaling is disabled
+	if(uncore_scaling && current_uncore_pstate >= 0)
+		uncore_frequency = uncore_pstate[current_uncore_pstate]/1000;
+
+	double avg_round_length = 0;	// Expressed in milliseconds
+	if(round_lengths_count > 0)
+		avg_round_length = ((double) round_lengths_time) / round_lengths_count / 1000000;
+
+	fprintf(fd,"Net_runtime: %lf\tNet_throughput: %lf\tNet_power: %lf\tNet_commits: %ld\tNet_error: %lf\tDVFS_transitions: %ld\tDVFS_avg_latency: %lf\tDVFS_max_latency: %lf\tCommit_overhead: %lf\tAsync_controller: %d\tNet_core_power: %lf\tNet_dram_power: %lf\tEnergy_wraparounds: %ld\tDVFS_domain: %d\tUncore_frequency: %d\tHW_power_limit: %d\tAvg_round_length: %lf\tBandit_moves: %ld\tBandit_neighbor_rounds: %ld\tPhase_changes: %ld\tPhases: %d\tConfig_cache: %d\tDuty_share: %lf\tObjective: %d\tNet_energy_per_commit: %lf\tNet_EDP: %lf\tRound_samples: ",time_in_seconds, net_throughput, net_avg_power, net_commits_sum, net_error_accumulator, dvfs_transitions, dvfs_avg_latency, ((double) dvfs_max_latency)/1000, commit_avg_overhead, async_controller, net_core_power, net_dram_power, energy_wraparounds, dvfs_domain, uncore_frequency, hw_power_limit, avg_round_length, ctl->bandit_moves, ctl->bandit_neighbor_rounds, ctl->phase_changes, declared_phases(), cache_warm_started, duty_cycle_mean_share(), ctl->objective, net_energy_per_commit, net_edp);
+
+	// Number of rounds merged in each step with adaptive rounds
+	for(i = 0; i < round_lengths_count; i++)
+		fprintf(fd, "%s%d", i == 0 ? "" : ",", round_lengths[i]);
+
+	// Best threads, p-state and time in seconds of each phase declared by the application
+	fprintf(fd, "\tPhase_configs: ");
+	print_phase_stats(fd);
 
-	fprintf(fd,"Net_runtime: %lf\tNet_throughput: %lf\tNet_power: %lf\tNet_commits: %ld\tNet_error: %lf\n",time_in_seconds, net_throughput, net_avg_power, net_commits_sum, net_error_accumulator);
+	// Threads, p-state, throughput and power of the Pareto frontier of the sampled configurations, by increasing power
+	fprintf(fd, "\tPareto_frontier: ");
+	print_pareto_stats(fd);
+	fprintf(fd, "\n");
 
 
 	fclose(fd);
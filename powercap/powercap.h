@@ -2,6 +2,8 @@
 #define __POWERCAP_HEADER
 
 #include "stats_t.h"
+#include "backend_t.h"
+#include "controller_t.h"
 #include "macros.h"
 #include <pthread.h>
 #include <unistd.h>
@@ -21,8 +23,11 @@ int nb_packages;				// Number of system package. Necessary to monitor energy con
 int cache_line_size;			// Size in byte of the cache line. Detected at startup and used to alloc memory cache aligned 
 int* pstate;					// Array of p-states initialized at startup with available scaling frequencies 
 int max_pstate;					// Maximum index of available pstate for the running machine 
-int current_pstate;				// Value of current pstate, index of pstate array which contains frequencies
-int steps;						// Number of steps required for the heuristic to converge 
+int current_pstate;				// Value of current pstate, index of pstate array which contains frequencies. With per-core DVFS it is the p-state of the active cores
+int* core_pstate;				// Current p-state of each core
+int* core_package;				// Package of each core
+int packed_cores;				// Number of cores running application threads. Cores from packed_cores to nb_cores-1 are parked by core packing
+power_backend_t* backend;		// Backend selected with power_backend, provides energy readings and actuators
 stats_t** stats_array;			// Pointer to pointers of struct stats_s, one for each thread 	
 volatile int round_completed;   // Defines if round completed and thread 0 should collect stats and call the heuristic function
 volatile int thread_counter;	// Global variable used for assigning an increasing counter to threads
@@ -32,12 +37,11 @@ volatile int cond_waiters;		// Used to manage phread conditional wait. It's incr
 int current_ramp_up_commits;	// Used to filter out the initial commits
 
 // powercap_config.txt variables
-int starting_threads;			// Number of threads running at the start of the exploration
 int static_pstate;				// Static -state used for the execution with heuristic 8
-double power_limit;				// Maximum power that should be used by the application expressed in Watt
 int total_commits_round; 		// Number of total commits for each heuristics step 
-int heuristic_mode;				// Used to switch between different heuristics mode. Check available values in heuristics.  
-int detection_mode; 			// Defines the detection mode. Value 0 means detection is disabled. 1 restarts the exploration from the start. Detection mode 2 resets the execution after a given number of steps
+double round_duration;			// Duration of each heuristics step expressed in milliseconds. If higher than 0 it replaces total_commits_round
+double round_confidence;		// If higher than 0, a step is extended by further rounds until the 95% confidence intervals of throughput and power are within this percentage of their mean
+int round_max_samples;			// Maximum number of rounds merged in a single step with round_confidence
 int exploit_steps;				// Number of steps that should be waited until the next exploration is started
 double power_uncore;			// System specific parameter that defines the amount of power consumption used by the uncore part of the system, which we consider to be constant
 int min_cpu_freq;			// Minimum cpu frequency (in KHz)	
@@ -49,6 +53,75 @@ int window_size; 				// Defines the lenght of the window, defined in steps, that
 double hysteresis;				// Defines the amount in percentage of hysteresis that should be applied when deciding the next step in a window based on the current value of window_power. Used by dynamic_heuristic1. Defined in hope_config.txt
 int ramp_up_commits;			// Input parameter to set the number of ramp up commits
 int lower_sampled_model_pstate;		// Define the lower sampled pstate to compute the model
+double model_forgetting;		// Forgetting factor of the online models, 1 weights all the samples equally
+int model_sampled_threads;		// Number of thread counts sampled by the setup of heuristic 15, the others are interpolated. 0 samples all of them
+char sysfs_root[256];			// Root of the sysfs tree, normally /sys. Can point to a fake tree to run without cpufreq and RAPL
+int power_backend;				// 0 -> energy and frequency through RAPL and cpufreq sysfs files, 1 -> through the msr devices, 2 -> simulated
+char msr_root[256];				// Root of the msr devices, normally /dev. Can point to a tree of regular files that act as fake devices
+double sim_alfa;				// Coefficient of f^3 for each active thread in the power model of the simulated backend, with f expressed in GHz
+double sim_beta;				// Coefficient of f for each active thread in the power model of the simulated backend
+double sim_noise;				// Standard deviation of the noise added by the simulated backend, expressed in percentage of the power
+double sim_phase_period;		// If higher than 0, the simulated backend alternates two phases of this duration, expressed in milliseconds
+double sim_phase_scale;			// Power of the odd phases of the simulated backend relative to the even ones
+double change_delta;			// Deviation from the reference, in percentage, tolerated by the phase change detection of detection mode 5
+double change_threshold;		// Cumulative deviation, in percentage, that triggers a phase change with detection mode 5
+int dvfs_domain;				// 0 -> one p-state for all cores, 1 -> p-state per core, 2 -> p-state per package. 1 and 2 require core packing
+int idle_pstate;				// P-state of the parked cores with per-core or per-package DVFS. Set to -1 to use the lowest frequency
+int uncore_scaling;				// 0 -> uncore frequency left to the hardware, 1 -> uncore frequency explored after the core configuration
+int hw_power_limit;				// 0 -> power cap enforced by the heuristics only, 1 -> power cap also programmed in the RAPL package zones
+long hw_time_window;			// Time window of the RAPL power limit, expressed in micro seconds
+double uncore_tolerance;		// Throughput loss, in percentage of the throughput at the highest uncore frequency, accepted when lowering the uncore frequency
+int phase_aware;				// 0 -> phase markers ignored, 1 -> each phase marked by the application learns its own configuration
+double phase_sample_time;		// Minimum duration of the visits merged in a sample of a phase, expressed in milliseconds
+int config_cache;				// 0 -> every run explores from scratch, 1 -> configurations saved in cache_dir and reused by the next runs
+char cache_dir[256];			// Directory of the configuration cache files
+int duty_cycling;				// 0 -> exploitation fluctuates between BEST, HIGH and LOW, 1 -> alternates two p-states within each round to run at power_limit
+double duty_period;				// Period of the alternation of the two p-states with duty_cycling, expressed in milliseconds
+char control_socket[108];		// Path of the Unix domain socket that accepts control commands, none to disable it
+double node_budget;				// Power budget shared by the processes running on the node, expressed in Watt. 0 -> each process uses power_limit
+char node_file[256];			// File mapped by the processes that share node_budget
+double node_period;				// Interval between two redistributions of node_budget, expressed in milliseconds
+char trace_file[256];			// File where the rounds are recorded for the replay tool, none to disable the trace
+
+// Uncore frequency variables
+int* uncore_pstate;				// Array of uncore p-states, expressed in KHz. Uncore p-state 0 is the highest frequency
+int max_uncore_pstate;			// Maximum index of uncore_pstate
+int current_uncore_pstate;		// Current uncore p-state, -1 if not set yet
+int uncore_searching;			// 1 while the uncore frequency is explored at the best core configuration
+double uncore_reference_throughput;	// Throughput at the uncore p-state where the uncore exploration started
+double uncore_reference_power;		// Power at the uncore p-state where the uncore exploration started
+int uncore_reference_pstate;	// Uncore p-state where the uncore exploration started
+int best_uncore_pstate;			// Lowest uncore p-state found within uncore_tolerance
+
+// Adaptive round variables. Each round is a sample, samples are merged until the confidence intervals are narrow enough
+int round_samples;				// Number of samples of the current step
+long round_start_epoch;			// Value of config_epoch at the start of the first sample of the current step
+long round_time_sum;			// Time of the samples of the current step, expressed in nano seconds
+long round_energy_sum;			// Energy of the samples of the current step, expressed in micro Joule
+long round_commits_sum;			// Commits of the samples of the current step
+double round_throughput_mean;	// Running mean and sum of squared deviations of the throughput of the samples, Welford's method
+double round_throughput_m2;
+double round_power_mean;		// Running mean and sum of squared deviations of the power of the samples
+double round_power_m2;
+int* round_lengths;				// Number of samples chosen for each step, reported in the stats file
+long round_lengths_count;
+long round_lengths_size;
+long round_lengths_time;		// Sum of the length of all the steps, expressed in nano seconds
+
+// Asynchronous controller variables
+int async_controller;			// 0 -> heuristic called inline by the committing thread, 1 -> heuristic called by a dedicated controller thread
+volatile int pending_threads;	// Number of threads requested by the controller thread, still to be applied by the master thread. 0 if none
+volatile long config_epoch;		// Incremented by the controller thread each time the configuration changes, used to discard mixed rounds
+long controller_dropped_samples;	// Samples dropped because the queue was full
+long controller_stale_samples;	// Samples discarded because they were measured across a configuration change
+long commit_overhead_time;		// Time spent in powercap code by the committing thread at round boundaries, expressed in nano seconds
+long commit_overhead_rounds;	// Number of rounds accounted in commit_overhead_time
+
+// DVFS actuator statistics, expressed in nano seconds
+long dvfs_transitions;			// Number of p-state transitions applied by set_pstate()
+long dvfs_latency_sum;			// Sum of the latencies of all transitions
+long dvfs_last_latency;			// Latency of the last transition
+long dvfs_max_latency;			// Highest latency observed for a single transition
 
 // Variable specific to NET_STATS
 long net_time_sum;
@@ -56,6 +129,12 @@ long net_energy_sum;
 long net_commits_sum;
 long net_aborts_sum;
 
+// Variables necessary to compute the power consumption of the RAPL subdomains
+long net_subdomain_time_start;
+long net_core_energy_start;
+long net_dram_energy_start;
+long energy_wraparounds;		// Number of wraparounds of the energy counters corrected by get_energy()
+
 // Variables necessary to compute the error percentage from power_limit, computed once every seconds 
 long net_time_slot_start;
 long net_energy_slot_start;
@@ -63,65 +142,16 @@ long net_time_accumulator;
 double net_error_accumulator; 
 long net_discard_barrier;
 
-// Variables necessary for the heuristics
-double old_throughput;			
-double old_power;			
-double old_abort_rate; 		
-double old_energy_per_tx;	
-double best_throughput;
-int current_exploit_steps;		// Current number of steps since the last completed exploration
-int best_threads;				
-int best_pstate;	
-double best_power;			
-double level_best_throughput; 
-int level_best_threads;
-int level_best_pstate;
-int level_starting_threads;
-int level_starting_energy_per_tx;
-int phase0_pstate;
-int phase0_threads;
-int new_pstate;					// Used to check if just arrived to a new p_state in the heuristic search
-int decreasing;					// If 0 heuristic should remove threads until it reaches the limit  
-int stopped_searching;			// While 1 the algorithm searches for the best configuration, if 0 the algorithm moves to monitoring mode 
-int phase;						// The value of phase has different semantics based on the running heuristic mode
-int min_pstate_search;
-int max_pstate_search;
-int min_thread_search;
-int max_thread_search;
-double min_thread_search_throughput;
-double max_thread_search_throughput;
-
-// Variables specific to dynamic_heuristic1 
-double high_throughput;
-int high_pstate;
-int high_threads; 
-double high_power;
-double low_throughput; 
-int low_pstate;
-int low_threads; 
-double low_power;
-int current_window_slot;		// Current slot within the window
-double window_time;				// Expressed in nano seconds. Defines the current sum of time passed in the current window of configuration fluctuation
-double window_power; 			// Expressed in Watt. Current average power consumption of the current fluctuation window
-int fluctuation_state;			// Defines the configuration used during the last step, -1 for LOW, 0 for BEST, 1 for HIGH
-
-
-// Model-based variables
-// Matrices of predicted power consumption and throughput for different configurations. 
-// Rows are p-states, columns are threads. It has total_threads+1 column as first column is filled with 0s 
-// since it is not meaningful to run with 0 threads.
-double** power_model; 
-double** throughput_model;
-double** power_validation; 
-double** throughput_validation;
-double** power_real; 
-double** throughput_real;
-int validation_pstate;	// Variable necessary to validate the effectiveness of the models
+int cache_warm_started;			// 1 if the exploration was replaced by the best configuration of the configuration cache
 
 // Barrier detection variables
 int barrier_detected; 			// If set to 1 should drop current statistics round, had to wake up all threads in order to overcome a barrier 
 int pre_barrier_threads;	    // Number of threads before entering the barrier, should be restored afterwards
 
+// Controllers
+controller_t main_controller;	// Controller driven by the runtime, its settings are loaded from powercap_config.txt
+extern __thread controller_t* ctl;	// Controller of the calling thread, used by the heuristics. Points to main_controller unless changed with controller_select()
+
 // Debug variables
 long lock_counter; 
 
@@ -143,10 +173,65 @@ void powercap_init(int);
 void powercap_init_thread(void);
 void powercap_print_stats(void);
 void powercap_commit_work(void);
+void powercap_phase_begin(int);
+void powercap_phase_end(void);
+void powercap_set_power_limit(double);
+
+// Controllers, see controller_state.c
+controller_t* controller_create(int, int (*)(int), void (*)(int));
+void controller_init(controller_t*);
+void controller_start(void);
+void controller_select(controller_t*);
+void controller_step(double, double, long);
+void controller_free(controller_t*);
 
 // Functions used by heuristics
 void set_threads(int);
+void schedule_threads(int);
 int set_pstate(int);
+void set_core_pstate(int, int);
+void set_idle_pstate(int);
+void update_core_pstates(void);
+void set_boost(int);
+int set_uncore_pstate(int);
+void update_uncore_power_delta(double);
+double get_uncore_power(int);
+void heuristic_bayesian(double, double);
+void heuristic_mpc(double, double);
+void bandit_exploit(double, double);
+void bandit_reset(void);
+void change_detector_reset(void);
+int detect_phase_change(double, double);
+void model_add_sample(int, int, double, double);
+void model_record_setup_sample(int, int, double, double);
+int model_next_threads(int);
+void model_interpolate_threads(int, int);
+double model_power(int, int);
+double model_throughput(int, int);
+double model_power_stddev(int, int);
+double model_throughput_stddev(int, int);
+int declared_phases(void);
+void pareto_add_sample(int, int, double, double);
+int apply_pending_power_limit(void);
+int control_round(double, double);
+void node_budget_round(double);
+double objective_score(double, double);
+char* objective_suffix(void);
+void init_model_matrices(void);
+void free_online_model(controller_t*);
+int online_model_finite(controller_t*);
+void free_mpc(controller_t*);
+void free_pareto(controller_t*);
+int config_cache_stale(double);
+void duty_cycle_update(double, double, long);
+void duty_cycle_reset(void);
+int duty_cycle_active(void);
+void duty_cycle_lock(void);
+void duty_cycle_unlock(void);
+void set_hw_power_limit(double);
+void restore_hw_power_limit();
+long get_time(void);
+long get_energy(void);
 
 
 #endif
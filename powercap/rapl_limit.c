@@ -0,0 +1,189 @@
+#include "powercap.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// RAPL hardware power limit
+///////////////////////////////////////////////////////////////
+
+// With hw_power_limit the power cap is also programmed in constraint_0 (long term) of each package zone of the powercap sysfs,
+// so that the hardware enforces it at millisecond granularity while the heuristics choose threads and p-states within the envelope.
+// power_limit is split evenly among the packages. The original limit, time window and enabled state of each zone are saved by
+// init_hw_power_limit() and restored by restore_hw_power_limit() at the end of the execution.
+// The zone settings outlive the process, so the restore is also registered with atexit() for the exit() calls on errors, and runs
+// in the handlers of the termination and crash signals that are not handled by the application. A SIGKILL cannot be caught and
+// leaves the zones capped at power_limit with hw_time_window, until the next run with hw_power_limit or a manual restore.
+
+#define HW_LIMIT_SIGNALS 9
+
+typedef struct rapl_zone_limit{
+	long power_limit;		// Original constraint_0_power_limit_uw
+	long time_window;		// Original constraint_0_time_window_us
+	int enabled;			// Original value of enabled
+	char directory[448];	// Directory of the zone with a trailing slash, built in advance for the signal handlers
+} rapl_zone_limit_t;
+
+static rapl_zone_limit_t* saved_zone_limits;
+static volatile sig_atomic_t hw_limit_programmed;	// 1 from init_hw_power_limit() until the original settings are restored
+static int hw_limit_signals[HW_LIMIT_SIGNALS] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+
+static long read_zone_long(int package, char* file){
+
+	char fname[512];
+	FILE* zone_file;
+	long value = -1;
+
+	sprintf(fname, "%s/class/powercap/intel-rapl/intel-rapl:%d/%s", sysfs_root, package, file);
+	zone_file = fopen(fname, "r");
+	if(zone_file == NULL)
+		return -1;
+	if(fscanf(zone_file, "%ld", &value) != 1)
+		value = -1;
+	fclose(zone_file);
+
+	return value;
+}
+
+static void write_zone_long(int package, char* file, long value){
+
+	char fname[512];
+	FILE* zone_file;
+
+	sprintf(fname, "%s/class/powercap/intel-rapl/intel-rapl:%d/%s", sysfs_root, package, file);
+	zone_file = fopen(fname, "w");
+	if(zone_file == NULL){
+		printf("Error opening %s. Programming the RAPL power limit requires superuser privileges\n", fname);
+		exit(1);
+	}
+	fprintf(zone_file, "%ld", value);
+	fclose(zone_file);
+}
+
+// Writes a zone file using only async-signal-safe calls, as it also runs in signal handlers. Errors are ignored, as the restore
+// must go on with the other files and zones
+static void restore_zone_long(rapl_zone_limit_t* zone, char* file, long value){
+
+	char fname[512], digits[24], *number = digits+sizeof(digits);
+	int fd;
+
+	*(--number) = '\0';
+	do{
+		*(--number) = '0' + value%10;
+		value /= 10;
+	}while(value > 0);
+
+	strcpy(fname, zone->directory);
+	strcat(fname, file);
+
+	if((fd = open(fname, O_WRONLY | O_TRUNC)) < 0)
+		return;
+	if(write(fd, number, strlen(number)) < 0){
+		// Nothing else can be done in a signal handler
+	}
+	close(fd);
+}
+
+static void restore_hw_power_limit_signal(int sig){
+
+	restore_hw_power_limit();
+
+	// The handler was installed with SA_RESETHAND, the signal is raised again to terminate with the default action
+	raise(sig);
+}
+
+// Registers the restore at exit and in the handlers of the signals left to their default action by the application
+static void register_hw_power_limit_restore(){
+
+	struct sigaction action, previous;
+	int i;
+
+	atexit(restore_hw_power_limit);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = restore_hw_power_limit_signal;
+	action.sa_flags = SA_RESETHAND;
+	sigemptyset(&action.sa_mask);
+
+	for(i = 0; i < HW_LIMIT_SIGNALS; i++){
+		if(sigaction(hw_limit_signals[i], NULL, &previous) == 0 && previous.sa_handler == SIG_DFL)
+			sigaction(hw_limit_signals[i], &action, NULL);
+	}
+}
+
+// Programs power_limit, expressed in Watt, on all the package zones
+void set_hw_power_limit(double limit){
+
+	int i;
+
+	if(!hw_power_limit || !hw_limit_programmed)
+		return;
+
+	for(i = 0; i < nb_packages; i++)
+		write_zone_long(i, "constraint_0_power_limit_uw", (long) (limit/nb_packages*1000000));
+}
+
+// Saves the current settings of the package zones and programs power_limit with the time window hw_time_window
+void init_hw_power_limit(){
+
+	int i;
+
+	if(!hw_power_limit)
+		return;
+
+	if(power_backend == 2){
+		printf("The hardware power limit is not available with the simulated backend. Using software control only\n");
+		hw_power_limit = 0;
+		return;
+	}
+
+	saved_zone_limits = malloc(sizeof(rapl_zone_limit_t)*nb_packages);
+
+	for(i = 0; i < nb_packages; i++){
+		saved_zone_limits[i].power_limit = read_zone_long(i, "constraint_0_power_limit_uw");
+		saved_zone_limits[i].time_window = read_zone_long(i, "constraint_0_time_window_us");
+		saved_zone_limits[i].enabled = (int) read_zone_long(i, "enabled");
+		sprintf(saved_zone_limits[i].directory, "%s/class/powercap/intel-rapl/intel-rapl:%d/", sysfs_root, i);
+
+		if(saved_zone_limits[i].power_limit < 0 || saved_zone_limits[i].time_window < 0){
+			printf("Cannot read constraint_0 of package %d\n", i);
+			exit(1);
+		}
+	}
+
+	// All the zones are saved before changing any of them, so that the restore never writes values that were not read
+	hw_limit_programmed = 1;
+	register_hw_power_limit_restore();
+
+	for(i = 0; i < nb_packages; i++){
+		write_zone_long(i, "constraint_0_time_window_us", hw_time_window);
+		if(saved_zone_limits[i].enabled == 0)
+			write_zone_long(i, "enabled", 1);
+
+		#ifdef DEBUG_HEURISTICS
+		printf("Package %d hardware power limit - original %lf Watt - time window %ld us\n", i, ((double) saved_zone_limits[i].power_limit)/1000000, saved_zone_limits[i].time_window);
+		#endif
+	}
+
+	set_hw_power_limit(ctl->power_limit);
+}
+
+// Restores the settings of the package zones saved by init_hw_power_limit(). Runs once, from powercap_print_stats(), at exit or
+// in a signal handler, whichever comes first
+void restore_hw_power_limit(){
+
+	int i;
+
+	if(!hw_power_limit || !hw_limit_programmed)
+		return;
+	hw_limit_programmed = 0;
+
+	for(i = 0; i < nb_packages; i++){
+		restore_zone_long(&saved_zone_limits[i], "constraint_0_power_limit_uw", saved_zone_limits[i].power_limit);
+		restore_zone_long(&saved_zone_limits[i], "constraint_0_time_window_us", saved_zone_limits[i].time_window);
+		if(saved_zone_limits[i].enabled == 0)
+			restore_zone_long(&saved_zone_limits[i], "enabled", 0);
+	}
+}
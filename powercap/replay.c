@@ -0,0 +1,371 @@
+#include "powercap.c"
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Offline replay of the heuristics
+///////////////////////////////////////////////////////////////
+
+// Replays the heuristics on a surface that gives the throughput and power of each configuration, without running the application.
+// The surface is either built from a trace recorded with trace_file, averaging the rounds of each configuration, or synthesized
+// with the power model of the simulated backend and a Universal Scalability Law for throughput:
+// X(N, f) = REPLAY_THROUGHPUT * N/(1 + sigma*(N-1) + kappa*N*(N-1)) / (memory + (1-memory)*f_max/f)
+// Configurations never run in the trace take the values of the closest recorded configuration, scaled linearly with the threads.
+// Each heuristic runs on its own thread with its own controller, whose actuators only record the configuration. At each round the
+// controller receives the values of its configuration perturbed by a gaussian noise of sim_noise percent, and the round lasts the
+// time of commits_round commits. With sim_phase_period the power of every other period of replayed time is multiplied by
+// sim_phase_scale, as in the simulated backend. The other settings are read from powercap_config.txt, the runtime services (uncore scaling,
+// duty cycling, phases, configuration cache, node budget) are disabled. For each heuristic it reports:
+// - Convergence_rounds: rounds of the first exploration, -1 if it never stops searching, as heuristic 18
+// - Cap_violation: percentage of the rounds run at a configuration whose power without noise is higher than power_limit
+// - Avg_excess_power: mean power above power_limit of those rounds, expressed in Watt
+// - Efficiency: mean score of the objective of the rounds, in percentage of the best configuration within power_limit
+// - Model_finite: 0 if the online models of heuristics 15 and 18 ended with coefficients or covariances that are not finite
+//
+// Usage: replay.x [-trace <file> | -synthetic] [-heuristic_modes 9,10,...] [-detection_mode <d>] [-power_limit <w>] [-rounds <n>]
+//                 [-threads <n>] [-pstates <n>] [-sigma <s>] [-kappa <k>] [-memory <m>]
+
+#define REPLAY_THROUGHPUT 100		// Throughput of a single thread at the highest frequency of the synthetic surface
+#define REPLAY_MAX_RUNS 16
+
+typedef struct replay_run{
+	int heuristic_mode;
+	pthread_t thread;
+	long convergence_rounds;		// Rounds of the first exploration, -1 if none completed
+	long explorations;				// Number of completed explorations
+	long violation_rounds;			// Rounds above power_limit
+	double excess_power_sum;		// Sum of the power above power_limit of those rounds
+	double score_sum;				// Sum of the score of the objective of all the rounds
+	double elapsed;					// Expressed in seconds
+	int model_finite;				// Result of online_model_finite() at the end of the replay
+} replay_run_t;
+
+static double** surface_throughput;	// Rows are p-states, columns are threads, as the model matrices
+static double** surface_power;
+static long replay_rounds = 1000000;
+
+// Xorshift generator, returns a uniform value in (0,1]
+static double replay_random(unsigned long* state){
+
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return ((double) (*state >> 11) + 1) / 9007199254740992.0;
+}
+
+static double replay_noise(unsigned long* state){
+
+	double noise = 1 + sim_noise/100*sqrt(-2*log(replay_random(state)))*cos(2*M_PI*replay_random(state));
+
+	return noise > 0 ? noise : 0;
+}
+
+// Actuators of the replay controllers, the configuration is recorded by set_pstate() and set_threads()
+static int replay_apply_pstate(int input_pstate){
+	return input_pstate < 0 || input_pstate > max_pstate ? -1 : 0;
+}
+
+static void replay_apply_threads(int threads){
+
+	if(threads < 1 || threads > total_threads){
+		printf("Setting threads/cores to %d which is invalid for this system\n", threads);
+		exit(1);
+	}
+}
+
+// Fills the configurations never run with the closest one that ran, assuming throughput and core power linear with the threads
+static void replay_fill_surface(double** time){
+
+	int i, j, k, l, closest_pstate = 0, closest_threads = 1;
+	double distance, closest_distance, scale;
+
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			if(time[i][j] > 0)
+				continue;
+
+			closest_distance = -1;
+			for(k = 0; k <= max_pstate; k++){
+				for(l = 1; l <= total_threads; l++){
+					distance = fabs(((double) (k-i))/(max_pstate+1)) + fabs(((double) (l-j))/total_threads);
+					if(time[k][l] > 0 && (closest_distance < 0 || distance < closest_distance)){
+						closest_distance = distance;
+						closest_pstate = k;
+						closest_threads = l;
+					}
+				}
+			}
+
+			scale = ((double) j)/closest_threads;
+			surface_throughput[i][j] = surface_throughput[closest_pstate][closest_threads]*scale;
+			surface_power[i][j] = power_uncore + (surface_power[closest_pstate][closest_threads] - power_uncore)*scale;
+		}
+	}
+}
+
+static void replay_load_trace(char* file_name){
+
+	FILE* fd;
+	trace_header_t header;
+	trace_record_t record;
+	int32_t frequency;
+	double **time, **energy, **commits;
+	long rounds = 0;
+	int i, j, sampled = 0;
+
+	if((fd = fopen(file_name, "r")) == NULL){
+		printf("Error opening the trace file %s\n", file_name);
+		exit(1);
+	}
+
+	if(fread(&header, sizeof(header), 1, fd) != 1 || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.total_threads < 1 || header.max_pstate < 0){
+		printf("%s is not a trace recorded with trace_file\n", file_name);
+		exit(1);
+	}
+
+	total_threads = header.total_threads;
+	max_pstate = header.max_pstate;
+	pstate = malloc(sizeof(int)*(max_pstate+1));
+	for(i = 0; i <= max_pstate; i++){
+		if(fread(&frequency, sizeof(frequency), 1, fd) != 1){
+			printf("The trace file %s is truncated\n", file_name);
+			exit(1);
+		}
+		pstate[i] = frequency;
+	}
+
+	time = pareto_alloc_matrix();
+	energy = pareto_alloc_matrix();
+	commits = pareto_alloc_matrix();
+	while(fread(&record, TRACE_RECORD_SIZE, 1, fd) == 1){
+		if(record.pstate < 0 || record.pstate > max_pstate || record.threads < 1 || record.threads > total_threads || record.time <= 0)
+			continue;
+		time[record.pstate][record.threads] += record.time;
+		energy[record.pstate][record.threads] += record.energy;
+		commits[record.pstate][record.threads] += record.commits;
+		rounds++;
+	}
+	fclose(fd);
+
+	surface_throughput = pareto_alloc_matrix();
+	surface_power = pareto_alloc_matrix();
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			if(time[i][j] > 0){
+				surface_throughput[i][j] = commits[i][j] / (time[i][j]/1000000000);
+				surface_power[i][j] = energy[i][j] / (time[i][j]/1000);
+				sampled++;
+			}
+		}
+	}
+
+	if(sampled == 0){
+		printf("The trace file %s has no rounds\n", file_name);
+		exit(1);
+	}
+
+	printf("Trace %s: %ld rounds - %d threads - %d p-states - %d of %d configurations recorded\n", file_name, rounds, total_threads, max_pstate+1,
+		sampled, (max_pstate+1)*total_threads);
+
+	replay_fill_surface(time);
+}
+
+static void replay_synthesize(int threads, int pstates, double sigma, double kappa, double memory){
+
+	double f, f_max;
+	int i, j;
+
+	if(threads < 1 || pstates < 2 || memory < 0 || memory > 1){
+		printf("The synthetic surface needs at least 1 thread, 2 p-states and memory in the range from 0 to 1\n");
+		exit(1);
+	}
+
+	total_threads = threads;
+	max_pstate = pstates-1;
+	pstate = malloc(sizeof(int)*(max_pstate+1));
+	for(i = 0; i <= max_pstate; i++)
+		pstate[i] = max_cpu_freq - (max_cpu_freq - min_cpu_freq)*i/max_pstate;
+
+	f_max = pstate[0];
+	surface_throughput = pareto_alloc_matrix();
+	surface_power = pareto_alloc_matrix();
+	for(i = 0; i <= max_pstate; i++){
+		f = pstate[i];
+		for(j = 1; j <= total_threads; j++){
+			surface_throughput[i][j] = REPLAY_THROUGHPUT*j/(1 + sigma*(j-1) + kappa*j*(j-1)) / (memory + (1-memory)*f_max/f);
+			surface_power[i][j] = sim_power(j, i);
+		}
+	}
+
+	printf("Synthetic surface: %d threads - %d p-states from %d to %d MHz - sigma %lf - kappa %lf - memory %lf\n", total_threads, max_pstate+1,
+		pstate[max_pstate]/1000, pstate[0]/1000, sigma, kappa, memory);
+}
+
+// Score of the best configuration within power_limit without noise, 0 if none
+static double replay_best_score(){
+
+	double score, best = 0;
+	int i, j;
+
+	for(i = 0; i <= max_pstate; i++){
+		for(j = 1; j <= total_threads; j++){
+			score = objective_score(surface_throughput[i][j], surface_power[i][j]);
+			if(surface_power[i][j] <= ctl->power_limit && score > best)
+				best = score;
+		}
+	}
+
+	return best;
+}
+
+static void* replay_thread(void* arg){
+
+	replay_run_t* run = (replay_run_t*) arg;
+	controller_t* controller = controller_create(run->heuristic_mode, replay_apply_pstate, replay_apply_threads);
+	unsigned long random_state = 88172645463325252UL + run->heuristic_mode;
+	double throughput, power;
+	long i, start_time, time, replay_time = 0;
+	int searching;
+
+	controller_select(controller);
+	start_time = get_time();
+
+	for(i = 0; i < replay_rounds; i++){
+		throughput = surface_throughput[ctl->current_pstate][ctl->active_threads];
+		power = surface_power[ctl->current_pstate][ctl->active_threads];
+		time = (long) (total_commits_round/throughput*1000000000);
+
+		// Synthetic phase changes as in the simulated backend, over the replayed time
+		if(sim_phase_period > 0 && ((long) (((double) replay_time)/(sim_phase_period*1000000))) % 2 == 1)
+			power *= sim_phase_scale;
+		replay_time += time;
+
+		if(power > ctl->power_limit){
+			run->violation_rounds++;
+			run->excess_power_sum += power - ctl->power_limit;
+		}
+		run->score_sum += objective_score(throughput, power);
+
+		searching = !ctl->stopped_searching;
+		controller_step(throughput*replay_noise(&random_state), power*replay_noise(&random_state), time);
+
+		if(searching && ctl->stopped_searching && run->explorations++ == 0)
+			run->convergence_rounds = i+1;
+	}
+
+	run->elapsed = ((double) (get_time() - start_time))/1000000000;
+	run->model_finite = online_model_finite(controller);
+	controller_free(controller);
+
+	return NULL;
+}
+
+int main(int argc, char** argv){
+
+	replay_run_t runs[REPLAY_MAX_RUNS];
+	char* trace_name = NULL;
+	char default_modes[] = "9,10,11,12,13,14,15,16,17,18";
+	char* modes = default_modes;
+	char* mode;
+	double limit = 0, sigma = 0.05, kappa = 0.002, memory = 0.3, best_score;
+	int i, nb_runs = 0, threads = 8, pstates = 0, detection = -1;
+
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-synthetic") == 0)
+			trace_name = NULL;
+		else if(i+1 < argc && strcmp(argv[i], "-trace") == 0)
+			trace_name = argv[++i];
+		else if(i+1 < argc && strcmp(argv[i], "-heuristic_modes") == 0)
+			modes = argv[++i];
+		else if(i+1 < argc && strcmp(argv[i], "-detection_mode") == 0)
+			detection = atoi(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-power_limit") == 0)
+			limit = atof(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-rounds") == 0)
+			replay_rounds = atol(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-threads") == 0)
+			threads = atoi(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-pstates") == 0)
+			pstates = atoi(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-sigma") == 0)
+			sigma = atof(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-kappa") == 0)
+			kappa = atof(argv[++i]);
+		else if(i+1 < argc && strcmp(argv[i], "-memory") == 0)
+			memory = atof(argv[++i]);
+		else{
+			printf("Usage: %s [-trace <file> | -synthetic] [-heuristic_modes 9,10,...] [-detection_mode <d>] [-power_limit <w>] [-rounds <n>] "
+				"[-threads <n>] [-pstates <n>] [-sigma <s>] [-kappa <k>] [-memory <m>]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	load_config_file();
+
+	// The runtime services are not replayed
+	uncore_scaling = 0;
+	duty_cycling = 0;
+	phase_aware = 0;
+	config_cache = 0;
+	node_budget = 0;
+	hw_power_limit = 0;
+
+	if(limit > 0)
+		ctl->power_limit = limit;
+	if(detection >= 0)
+		ctl->detection_mode = detection;
+
+	if(ctl->detection_mode < 0 || ctl->detection_mode > 5 || ctl->detection_mode == 3){
+		printf("Detection_mode must be 0, 1, 2, 4 or 5, the model validation of detection mode 3 is not replayed\n");
+		exit(1);
+	}
+
+	if(replay_rounds < 1){
+		printf("Rounds must be higher than 0\n");
+		exit(1);
+	}
+
+	if(trace_name != NULL)
+		replay_load_trace(trace_name);
+	else
+		replay_synthesize(threads, pstates > 0 ? pstates : (max_cpu_freq - min_cpu_freq)/100000 + 1, sigma, kappa, memory);
+
+	if(ctl->starting_threads > total_threads || lower_sampled_model_pstate > max_pstate){
+		printf("Starting_threads and lower_sampled_model_pstate must be within the threads and p-states of the surface\n");
+		exit(1);
+	}
+
+	best_score = replay_best_score();
+	printf("Power limit %lf Watt - objective %d - detection mode %d - %ld rounds - best score within the limit %lf\n", ctl->power_limit, ctl->objective,
+		ctl->detection_mode, replay_rounds, best_score);
+
+	for(mode = strtok(modes, ","); mode != NULL && nb_runs < REPLAY_MAX_RUNS; mode = strtok(NULL, ",")){
+		memset(&runs[nb_runs], 0, sizeof(replay_run_t));
+		runs[nb_runs].heuristic_mode = atoi(mode);
+		runs[nb_runs].convergence_rounds = -1;
+		if(runs[nb_runs].heuristic_mode < 8 || runs[nb_runs].heuristic_mode > 18){
+			printf("Heuristic mode %d is invalid, it must be in the range from 8 to 18\n", runs[nb_runs].heuristic_mode);
+			exit(1);
+		}
+		nb_runs++;
+	}
+
+	for(i = 0; i < nb_runs; i++){
+		if(pthread_create(&runs[i].thread, NULL, replay_thread, &runs[i]) != 0){
+			printf("Error creating the replay thread of heuristic %d\n", runs[i].heuristic_mode);
+			exit(1);
+		}
+	}
+
+	for(i = 0; i < nb_runs; i++){
+		pthread_join(runs[i].thread, NULL);
+		printf("Heuristic: %d\tConvergence_rounds: %ld\tExplorations: %ld\tCap_violation: %lf\tAvg_excess_power: %lf\tEfficiency: %lf\tRounds_per_second: %lf\tModel_finite: %d\n",
+			runs[i].heuristic_mode, runs[i].convergence_rounds, runs[i].explorations, 100*((double) runs[i].violation_rounds)/replay_rounds,
+			runs[i].violation_rounds > 0 ? runs[i].excess_power_sum/runs[i].violation_rounds : 0,
+			best_score > 0 ? 100*runs[i].score_sum/replay_rounds/best_score : 0, runs[i].elapsed > 0 ? replay_rounds/runs[i].elapsed : 0, runs[i].model_finite);
+	}
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include "powercap.h"
+
+
+
+///////////////////////////////////////////////////////////////
+// Simulated backend
+///////////////////////////////////////////////////////////////
+
+// Synthesizes the energy consumption of the package from the same cubic model fitted by compute_power_model():
+// power = power_uncore + active_threads * (sim_alfa * f^3 + sim_beta * f), with f expressed in GHz.
+// With core packing, the parked cores add SIM_PARKED_FRACTION of the same term computed at their own frequency.
+// With uncore scaling, power_uncore is the uncore power at the highest uncore frequency and scales linearly with the uncore frequency.
+// The energy is integrated over the real time spent in each configuration and perturbed by a gaussian noise with
+// standard deviation sim_noise percent of the power, drawn from a generator with a fixed seed.
+// With sim_phase_period the power of every other period is multiplied by sim_phase_scale, which injects synthetic phase changes.
+// It does not require RAPL, cpufreq or root privileges, so heuristics can be compared on any Linux box.
+
+#define SIM_PARKED_FRACTION 0.1	// Fraction of the power of an active core consumed by a parked core at the same frequency
+
+static long sim_energy;				// Expressed in micro Joule
+static long sim_last_time;			// Time of the last update of sim_energy
+static long sim_start_time;			// Time of sim_init(), start of the first phase
+static unsigned long sim_random_state;
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;	// get_energy() and set_pstate() might run on different threads with the asynchronous controller
+
+// Xorshift generator, returns a uniform value in (0,1]
+static double sim_random(){
+
+	sim_random_state ^= sim_random_state << 13;
+	sim_random_state ^= sim_random_state >> 7;
+	sim_random_state ^= sim_random_state << 17;
+
+	return ((double) (sim_random_state >> 11) + 1) / 9007199254740992.0;
+}
+
+// Standard normal value obtained with the Box-Muller transform
+static double sim_gaussian(){
+	return sqrt(-2*log(sim_random()))*cos(2*M_PI*sim_random());
+}
+
+// Power consumption of a single active core at the given p-state
+static double sim_core_power(int input_pstate){
+
+	double f;
+
+	if(input_pstate < 0)
+		return 0;
+
+	f = ((double) pstate[input_pstate])/1000000;
+	return sim_alfa*f*f*f + sim_beta*f;
+}
+
+// Power consumption of the current configuration, without noise. With core packing the parked cores are the ones from threads to nb_cores-1,
+// without it the threads are not bound to cores and no core is parked
+double sim_power(int threads, int input_pstate){
+
+	double power = power_uncore + threads*sim_core_power(input_pstate);
+	int i;
+
+	if(uncore_scaling && current_uncore_pstate >= 0)
+		power -= power_uncore*(1 - ((double) uncore_pstate[current_uncore_pstate])/uncore_pstate[0]);
+
+	if(core_packing){
+		for(i = threads; i < nb_cores; i++)
+			power += SIM_PARKED_FRACTION*sim_core_power(core_pstate[i]);
+	}
+
+	return power;
+}
+
+// Accounts the energy consumed by the current configuration since the last update
+static void sim_advance(){
+
+	long now = get_time();
+	double noise = 1 + sim_noise/100*sim_gaussian();
+
+	if(noise < 0)
+		noise = 0;
+
+	if(sim_phase_period > 0 && ((long) (((double) (now - sim_start_time))/(sim_phase_period*1000000))) % 2 == 1)
+		noise *= sim_phase_scale;
+
+	// Core 0 always runs application threads, its p-state is updated only after the energy has been accounted
+	sim_energy += (long) (sim_power(active_threads, core_pstate[0])*noise*((double) (now - sim_last_time))/1000);
+	sim_last_time = now;
+}
+
+static void sim_init(int threads){
+
+	int i;
+
+	init_DVFS_management_pstate_range();
+	nb_packages = 1;
+	core_package = malloc(sizeof(int)*nb_cores);
+	for(i = 0; i < nb_cores; i++)
+		core_package[i] = 0;
+
+	sim_energy = 0;
+	sim_last_time = get_time();
+	sim_start_time = sim_last_time;
+	sim_random_state = 88172645463325252UL;
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Simulated backend - alfa %lf - beta %lf - noise %lf%%\n", sim_alfa, sim_beta, sim_noise);
+	#endif
+
+	current_pstate = -1;
+	set_pstate(max_pstate);
+}
+
+static long sim_get_energy(){
+
+	long energy;
+
+	pthread_mutex_lock(&sim_lock);
+	sim_advance();
+	energy = sim_energy;
+	pthread_mutex_unlock(&sim_lock);
+
+	return energy;
+}
+
+static long sim_get_energy_subdomain(){
+	return 0;
+}
+
+// Called before current_pstate is updated, so the energy up to now is accounted to the previous p-state
+static void sim_set_frequency(int frequency){
+
+	pthread_mutex_lock(&sim_lock);
+	sim_advance();
+	pthread_mutex_unlock(&sim_lock);
+}
+
+static void sim_set_core_frequency(int core, int frequency){
+
+	pthread_mutex_lock(&sim_lock);
+	sim_advance();
+	pthread_mutex_unlock(&sim_lock);
+}
+
+// Threads are scheduled as with real hardware, the simulation only affects the energy consumption
+static void sim_set_threads(int to_threads){
+
+	pthread_mutex_lock(&sim_lock);
+	sim_advance();
+	pthread_mutex_unlock(&sim_lock);
+
+	schedule_threads(to_threads);
+}
@@ -7,6 +7,8 @@ typedef struct stats{
     int commits;                       // Number of commits in the current round
     long start_energy;                 // Value of energy consumption taken at the start of the round, expressed in micro joule
     long start_time;        		   // Start time of the current round
+    long start_epoch;                  // Value of config_epoch at the start of the round
+    long end_time;                     // Time at which the current round ends when rounds are defined by round_duration
   } stats_t;
 
   #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "powercap.h"
+#include <stdint.h>
+#include <string.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Round trace
+///////////////////////////////////////////////////////////////
+
+// With trace_file set to a path instead of none, powercap_commit_work() appends each measured round to trace_file as a fixed
+// size binary record, which replay.c turns into the throughput and power of each configuration to replay the heuristics offline.
+// The file starts with the number of threads and the frequencies of the p-states of the machine. Records are in the byte order
+// of the machine and go through the stdio buffer, so recording costs a copy of TRACE_RECORD_SIZE bytes per round.
+// Rounds discarded by a barrier or without energy updates are not recorded, rounds merged in an adaptive step are recorded one by one.
+// Rounds alternating two p-states with duty cycling are not recorded either, as they are not samples of a single configuration.
+
+#define TRACE_MAGIC 0x52544350		// "PCTR"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_SIZE 65536
+
+typedef struct trace_header{
+	uint32_t magic;
+	uint32_t version;
+	int32_t total_threads;
+	int32_t max_pstate;			// Followed by the frequencies of p-states 0 to max_pstate, expressed in KHz, as int32_t
+} trace_header_t;
+
+typedef struct trace_record{
+	int64_t time;				// Duration of the round, expressed in nano seconds
+	int64_t energy;				// Energy consumed in the round, expressed in micro Joule
+	int32_t commits;
+	int16_t threads;			// Configuration that ran the round
+	int16_t pstate;
+} trace_record_t;
+
+#define TRACE_RECORD_SIZE sizeof(trace_record_t)
+
+static FILE* trace_fd;
+static long trace_rounds;
+
+void init_trace(){
+
+	trace_header_t header;
+	int32_t frequency;
+	int i;
+
+	if(strcmp(trace_file, "none") == 0)
+		return;
+
+	if((trace_fd = fopen(trace_file, "w")) == NULL){
+		printf("Error opening the trace file %s\n", trace_file);
+		exit(1);
+	}
+	setvbuf(trace_fd, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.total_threads = total_threads;
+	header.max_pstate = max_pstate;
+	fwrite(&header, sizeof(header), 1, trace_fd);
+	for(i = 0; i <= max_pstate; i++){
+		frequency = pstate[i];
+		fwrite(&frequency, sizeof(frequency), 1, trace_fd);
+	}
+
+	trace_rounds = 0;
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Recording the rounds to %s\n", trace_file);
+	#endif
+}
+
+// Called by powercap_commit_work() for each round measured at the current configuration
+void trace_round(long time, long energy, long commits){
+
+	trace_record_t record;
+
+	if(trace_fd == NULL || duty_cycle_active())
+		return;
+
+	record.time = time;
+	record.energy = energy;
+	record.commits = commits;
+	record.threads = active_threads;
+	record.pstate = current_pstate;
+	fwrite(&record, TRACE_RECORD_SIZE, 1, trace_fd);
+	trace_rounds++;
+}
+
+void shutdown_trace(){
+
+	if(trace_fd == NULL)
+		return;
+
+	if(fclose(trace_fd) != 0)
+		printf("Error writing the trace file %s\n", trace_file);
+
+	#ifdef DEBUG_HEURISTICS
+	printf("%ld rounds recorded to %s\n", trace_rounds, trace_file);
+	#endif
+
+	trace_fd = NULL;
+}
@@ -0,0 +1,193 @@
+#include "powercap.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+
+
+///////////////////////////////////////////////////////////////
+// Uncore frequency scaling
+///////////////////////////////////////////////////////////////
+
+// The uncore frequency of each package is controlled through the intel_uncore_frequency driver, writing the same value to
+// min_freq_khz and max_freq_khz of package_XX_die_00. As for core p-states, uncore p-state 0 is the highest frequency and
+// each following uncore p-state is 100MHz slower, down to the minimum frequency reported by the driver.
+// The power consumed by the uncore is learned for each uncore p-state instead of being assumed constant, either as the difference
+// between package and core energy when the core RAPL subdomain is available, or from the power variations measured by uncore_search().
+// get_uncore_power() replaces the constant power_uncore in the power model of heuristic 15.
+
+static int* uncore_min_fd;
+static int* uncore_max_fd;
+static double* uncore_power_level;		// Learned uncore power for each uncore p-state, expressed in Watt. Negative if not learned yet
+static int uncore_core_domain;			// 1 if the core subdomain is available to separate the uncore power from the package power
+static long uncore_last_time;			// Time of the last sample of sample_uncore_power(), 0 if the next call should only start a new interval
+static long uncore_last_energy;			// Package energy of the last sample
+static long uncore_last_core_energy;	// Core energy of the last sample
+static int uncore_is_regular;			// Set to 1 if the files are regular files (fake sysfs tree), that must be truncated after each write
+
+static int read_uncore_khz(char* directory, char* file){
+
+	char fname[512];
+	FILE* uncore_file;
+	int value = -1;
+
+	sprintf(fname, "%s/%s", directory, file);
+	uncore_file = fopen(fname, "r");
+	if(uncore_file == NULL)
+		return -1;
+	if(fscanf(uncore_file, "%d", &value) != 1)
+		value = -1;
+	fclose(uncore_file);
+
+	return value;
+}
+
+static void write_uncore_khz(int fd, int frequency){
+
+	char frequency_string[16];
+	int len = sprintf(frequency_string, "%d", frequency);
+
+	if(pwrite(fd, frequency_string, len, 0) != len){
+		printf("Error writing uncore frequency\n");
+		exit(1);
+	}
+	if(uncore_is_regular && ftruncate(fd, len) != 0){
+		printf("Error truncating uncore frequency\n");
+		exit(1);
+	}
+}
+
+// Discovers the uncore frequency range of each package. Disables uncore scaling if the driver is not available
+void init_uncore_management(){
+
+	char directory[384], fname[512];
+	struct stat st;
+	int i, min_frequency = 0, max_frequency = 0, frequency;
+
+	max_uncore_pstate = 0;
+	current_uncore_pstate = -1;
+	uncore_searching = 0;
+
+	if(!uncore_scaling)
+		return;
+
+	uncore_min_fd = malloc(sizeof(int)*nb_packages);
+	uncore_max_fd = malloc(sizeof(int)*nb_packages);
+
+	for(i = 0; i < nb_packages; i++){
+		sprintf(directory, "%s/devices/system/cpu/intel_uncore_frequency/package_%02d_die_00", sysfs_root, i);
+
+		// The range is the same for all packages, the one of package 0 is used
+		if(i == 0){
+			min_frequency = read_uncore_khz(directory, "initial_min_freq_khz");
+			max_frequency = read_uncore_khz(directory, "initial_max_freq_khz");
+		}
+
+		sprintf(fname, "%s/min_freq_khz", directory);
+		uncore_min_fd[i] = open(fname, O_WRONLY);
+		sprintf(fname, "%s/max_freq_khz", directory);
+		uncore_max_fd[i] = open(fname, O_WRONLY);
+
+		if(min_frequency <= 0 || max_frequency < min_frequency || uncore_min_fd[i] < 0 || uncore_max_fd[i] < 0){
+			printf("Cannot access intel_uncore_frequency of package %d. Uncore scaling disabled\n", i);
+			uncore_scaling = 0;
+			return;
+		}
+	}
+
+	uncore_is_regular = (fstat(uncore_min_fd[0], &st) == 0 && S_ISREG(st.st_mode));
+	uncore_pstate = malloc(sizeof(int)*((max_frequency-min_frequency)/100000+1));
+	uncore_core_domain = get_energy_core() != 0;
+	uncore_last_time = 0;
+	uncore_power_level = malloc(sizeof(double)*((max_frequency-min_frequency)/100000+1));
+	for(frequency = max_frequency; frequency >= min_frequency; frequency -= 100000){
+		uncore_pstate[max_uncore_pstate] = frequency;
+		uncore_power_level[max_uncore_pstate] = -1;
+		max_uncore_pstate++;
+	}
+	max_uncore_pstate--;
+
+	#ifdef DEBUG_HEURISTICS
+	printf("Found %d uncore p-states in the range from %d MHz to %d MHz\n", max_uncore_pstate+1, uncore_pstate[max_uncore_pstate]/1000, uncore_pstate[0]/1000);
+	#endif
+
+	set_uncore_pstate(0);
+}
+
+int set_uncore_pstate(int input_pstate){
+
+	int i, frequency;
+
+	if(!uncore_scaling || input_pstate < 0 || input_pstate > max_uncore_pstate)
+		return -1;
+
+	if(current_uncore_pstate != input_pstate){
+		frequency = uncore_pstate[input_pstate];
+
+		// The driver rejects a minimum higher than the maximum, the order of the writes depends on the direction of the change
+		for(i = 0; i < nb_packages; i++){
+			if(current_uncore_pstate == -1 || input_pstate < current_uncore_pstate){
+				write_uncore_khz(uncore_max_fd[i], frequency);
+				write_uncore_khz(uncore_min_fd[i], frequency);
+			}else{
+				write_uncore_khz(uncore_min_fd[i], frequency);
+				write_uncore_khz(uncore_max_fd[i], frequency);
+			}
+		}
+
+		// Energy up to now is accounted to the previous uncore frequency
+		if(power_backend == 2)
+			get_energy();
+
+		current_uncore_pstate = input_pstate;
+		uncore_last_time = 0;
+	}
+	return 0;
+}
+
+// Updates the learned power of the current uncore p-state with a new sample
+static void update_uncore_power(double power){
+
+	if(!uncore_scaling || current_uncore_pstate < 0 || power <= 0)
+		return;
+
+	if(uncore_power_level[current_uncore_pstate] < 0)
+		uncore_power_level[current_uncore_pstate] = power;
+	else
+		uncore_power_level[current_uncore_pstate] = 0.9*uncore_power_level[current_uncore_pstate] + 0.1*power;
+}
+
+// Called at the end of each round with the package energy. Learns the power of the current uncore p-state as package minus core power
+void sample_uncore_power(long time, long energy){
+
+	long core_energy;
+
+	if(!uncore_scaling || !uncore_core_domain)
+		return;
+
+	core_energy = get_energy_core();
+	if(uncore_last_time != 0 && time > uncore_last_time)
+		update_uncore_power(((double) ((energy - uncore_last_energy) - (core_energy - uncore_last_core_energy))) / (((double) (time - uncore_last_time))/1000));
+
+	uncore_last_time = time;
+	uncore_last_energy = energy;
+	uncore_last_core_energy = core_energy;
+}
+
+// Called by uncore_search() with the package power at the current uncore p-state. Without the core subdomain, the uncore power is learned
+// as the power variation from the reference uncore p-state, added to the uncore power of the reference
+void update_uncore_power_delta(double power){
+
+	if(!uncore_scaling || uncore_core_domain)
+		return;
+
+	update_uncore_power(get_uncore_power(uncore_reference_pstate) + power - uncore_reference_power);
+}
+
+// Returns the uncore power of the given uncore p-state. Falls back to power_uncore if it was not learned yet
+double get_uncore_power(int input_pstate){
+
+	if(!uncore_scaling || input_pstate < 0 || input_pstate > max_uncore_pstate || uncore_power_level[input_pstate] < 0)
+		return power_uncore;
+
+	return uncore_power_level[input_pstate];
+}